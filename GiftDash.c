@@ -5,7 +5,9 @@
  *\date 30/12/2021
  */
 
+#include <getopt.h>
 #include <locale.h>
+#include <pthread.h>
 
 #include <allegro5/allegro.h>
 #include <allegro5/allegro_font.h>
@@ -22,12 +24,26 @@
 #include "nilorea/n_thread_pool.h"
 #include "nilorea/n_time.h"
 #include "nilorea/n_particles.h"
-
+#include "nilorea/n_profile.h"
+
+#include "asset_manager.h"
+#include "collision_grid.h"
+#include "collision_mask.h"
+#include "game_random.h"
+#include "hud_widget.h"
+#include "input_journal.h"
+#include "level_generator.h"
+#include "music_player.h"
 #include "sledge_physics.h"
+#include "sprite_batch.h"
 #include "states_management.h"
 #include "text_scroll.h"
+#include "world_snapshot.h"
 
 #define RESERVED_SAMPLES 16
+#define MAX_ASSETS 16
+#define MAX_PARTICLES 262144      /* hard cap on live particles */
+#define PARTICLE_FRAME_BUDGET 0.5 /* part of a displayed frame the particles update and drawing may take */
 #define MAX_SAMPLE_DATA 10
 
 /******************************************************************************
@@ -40,24 +56,37 @@ int DONE = 0,            /* Flag to check if we are always running */
 
 double drawFPS = 60.0;
 double logicFPS = 240.0;
+bool headless = 0;                     /* --headless: run the logic only, as fast as possible */
+long int headless_ticks = 10000;       /* --ticks: number of logic ticks of a headless run */
+bool headless_ticks_set = 0;           /* --ticks was given */
+uint64_t game_seed = 1;                /* --seed: seed of every random stream */
+char* journal_file = NULL;             /* --record or --replay file */
+bool journal_recording = 0;            /* --record: save the inputs of each logic tick */
+bool journal_replaying = 0;            /* --replay: take the inputs of each logic tick from journal_file */
+bool journal_replay_ended = 0;         /* all the replayed ticks were played */
+InputJournal input_journal;
+int particle_thread_threshold = 20000; /* number of particles from which the update is shared on the thread pool, 0 or negative to disable */
+int nb_good_presents = 25;             /* number of gifts to collect */
+int nb_bad_presents = 200;             /* number of Krampus items to avoid */
+long int world_width = 0,              /* size of the area holding the presents, 0 for 6 screens */
+    world_height = 0;
 
 ALLEGRO_DISPLAY* display = NULL;
 ALLEGRO_TIMER* fps_timer = NULL;
-ALLEGRO_TIMER* logic_timer = NULL;
 ALLEGRO_SAMPLE* sample_data[MAX_SAMPLE_DATA] = {NULL};
 ALLEGRO_EVENT_QUEUE* event_queue = NULL;
 
 N_TIME logic_chrono;
-N_TIME drawing_chrono;
 
 long int WIDTH = 1280, HEIGHT = 800;
 bool fullscreen = 0;
-char* bgmusic = NULL;
+char** playlist = NULL; /* bg-music tracks, NULL terminated */
+int music_buffer_count = MUSIC_BUFFER_COUNT, music_buffer_samples = MUSIC_BUFFER_SAMPLES;
+MusicPlayer music_player;
 
 THREAD_POOL* thread_pool = NULL;
 
-size_t logic_duration = 0;
-size_t drawing_duration = 0;
+char* trace_file = NULL; /* --trace: Chrome trace of the profiled zones, written on exit */
 
 bool backbuffer = 1;
 ALLEGRO_BITMAP* png_good = NULL;
@@ -67,15 +96,27 @@ ALLEGRO_BITMAP* bitmap = NULL;
 ALLEGRO_BITMAP* christmasPresents[16];
 ALLEGRO_BITMAP* bogeymanPresents[16];
 
-bool do_draw = 1, do_logic = 1, intro_text_scroll_enable = 1;
+bool do_draw = 1, intro_text_scroll_enable = 1;
 int mx = 0, my = 0, mouse_button = 0, mouse_b1 = 0, mouse_b2 = 0;
 
 int key[19] = {false, false, false, false, false, false, false, false, false,
                false, false, false, false, false, false, false, false, false};
+/* keys held, as seen by the display thread. The logic thread gets them in input_mask */
+int display_keys[19] = {false, false, false, false, false, false, false, false, false,
+                        false, false, false, false, false, false, false, false, false};
 
 ALLEGRO_BITMAP* santaSledgebmp = NULL;
+int good_icons_asset = -1, evil_icons_asset = -1, sledge_asset = -1; /* ids of the world images in the asset manager */
+CollisionMask christmas_masks[16], bogeyman_masks[16];                /* solid pixels of the presents icons */
+CollisionMask sledge_mask, sledge_pose_mask;                          /* solid pixels of the sledge, and of its rotated poses */
 VEHICLE santaSledge = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
 PARTICLE_SYSTEM* particle_system = NULL;
+PARTICLE_GOVERNOR particle_governor; /* scales the emissions to keep the particles in their frame budget */
+int snow_particles = -1, krampus_particles = -1, fireworks_particles = -1, trail_particles = -1, target_particles = -1, burst_particles = -1; /* governor categories */
+N_TIME particle_chrono, particle_draw_chrono;
+time_t particle_update_usec = 0; /* duration of the last particles update */
+long int particle_draw_usec = 0; /* duration of the last particles drawing, written by the display thread */
+long int krampus_particles_phase = 0; /* rotates the Krampus items showing particles while they are throttled */
 
 N_STR* textout = NULL;
 long int max_time = 30000000;
@@ -88,14 +129,66 @@ enum {
 typedef struct gift_dash_object {
     int type;
     int id;
+    int grid_index;  // index in its collision grid
     CollisionRectangle rect;
 } gift_dash_object;
 
 LIST* good_presents = NULL;
 LIST* bad_presents = NULL;
+CollisionGrid good_presents_grid; /* spatial index over good_presents, for drawing */
+CollisionGrid bad_presents_grid;  /* broad-phase over bad_presents, built once they are placed */
+
+#define MAX_COLLISION_CANDIDATES 256
+#define MAX_VISIBLE_OBJECTS 4096
+/* smallest world side: the placement spacing of the 128 pixels Krampus icons, the random fireworks need more than 64 */
+#define MIN_WORLD_SIZE 129
+
+PARTICLE_EMITTER gift_burst, krampus_burst, win_burst; /* bursts emitters: gift pickup, Krampus collision and win fireworks */
+TextManager start_text_manager, end_text_manager;
+HudField speed_hud, goodies_hud, time_hud;
+
+SpriteBatch presents_batch; /* presents drawings, grouped by texture */
+
+int visible_objects = 0; /* number of presents drawn in the last frame */
+bool show_stats = 0;     /* F9: display drawing stats */
 
 double tx = 0, ty = 0;
 
+// most logic ticks run in one pass of the logic thread. Beyond, the late time is dropped instead of
+// making each pass longer than the previous one
+#define MAX_CATCHUP_TICKS 8
+
+double previous_sledge_x = 0, previous_sledge_y = 0, previous_sledge_direction = 0; /* sledge before the last tick */
+
+SnapshotBuffer world_snapshots; /* what the logic thread hands to the display thread */
+uint32_t input_mask = 0;        /* display_keys packed by the display thread for the logic thread */
+int stop_logic = 0;             /* set by the display thread to end the logic thread */
+long int outro_ticks = -1;      /* logic ticks left before the win text scrolled away, -1 until the win */
+
+/* win text, scrolled by the display thread while the logic counts outro_ticks down */
+const char* outro_text[] = {
+    "WELL DONE ADVENTURER ! !",
+    " ",
+    "YOU GOT ALL THE PRESENTS BACK !",
+    " ",
+    "As a reward...",
+    " ",
+    "Enjoy the ride without any collision !",
+    " ",
+    "Thanks for playing :-)",
+    " ",
+    " ",
+    " ",
+    "GiftDash",
+    " ",
+    "KrampusHack 2024",
+    " ",
+    "By GullRaDriel"};
+#define OUTRO_LINES (int)(sizeof(outro_text) / sizeof(outro_text[0]))
+/* win text scroll speed in pixels per second, and the line height the logic assumes for its 48 pixels font */
+#define OUTRO_SCROLL_SPEED 80.0
+#define OUTRO_LINE_HEIGHT 48
+
 int check_item_collision(int x1, int y1, int w1, int h1, int x2, int y2, int w2, int h2) {
     // Check if one box is to the left, right, above, or below the other
     if (x1 + w1 <= x2 || x1 >= x2 + w2 || y1 + h1 <= y2 || y1 >= y2 + h2) {
@@ -104,6 +197,693 @@ int check_item_collision(int x1, int y1, int w1, int h1, int x2, int y2, int w2,
     return 1;  // Overlap
 }
 
+// index the presents of a list in a grid, keeping their index to remove them later
+bool build_presents_grid(CollisionGrid* grid, LIST* presents) {
+    CollisionRectangle* rects = NULL;
+    void** objects = NULL;
+    Malloc(rects, CollisionRectangle, presents->nb_items);
+    Malloc(objects, void*, presents->nb_items);
+    if (!rects || !objects) {
+        FreeNoLog(rects);
+        FreeNoLog(objects);
+        return false;
+    }
+    int nb = 0;
+    list_foreach(node, presents) {
+        gift_dash_object* item = node->ptr;
+        item->grid_index = nb;
+        rects[nb] = item->rect;
+        objects[nb] = item;
+        nb++;
+    }
+    bool ret = init_collision_grid(grid, rects, objects, nb, 256);
+    Free(rects);
+    Free(objects);
+    return ret;
+}
+
+// time of the first solid pixel of the sledge move touching an item, from the time their boxes touch, or -1
+double sledge_item_impact(double x0, double y0, double direction0, double from, const CollisionMask* item_mask, CollisionRectangle rect) {
+    return swept_mask_collision(&sledge_pose_mask, &sledge_mask, 0, al_get_bitmap_height(santaSledgebmp) / 2.0, x0, y0, DEG_TO_RAD(direction0), santaSledge.x, santaSledge.y, DEG_TO_RAD(santaSledge.direction), from, item_mask, (int)rect.x, (int)rect.y);
+}
+
+// free the collision masks of the world images
+void free_world_masks(void) {
+    for (int it = 0; it < 16; it++) {
+        free_collision_mask(&christmas_masks[it]);
+        free_collision_mask(&bogeyman_masks[it]);
+    }
+    free_collision_mask(&sledge_mask);
+    free_collision_mask(&sledge_pose_mask);
+}
+
+// queue the drawing of a present and its outline
+void draw_present(ALLEGRO_BITMAP* bmp, CollisionRectangle rect, ALLEGRO_COLOR outline_color) {
+    sprite_batch_draw(&presents_batch, bmp, rect.x - tx, rect.y - ty);
+
+    // Get the dimensions of the bitmap
+    int bitmap_width = al_get_bitmap_width(bmp);
+    int bitmap_height = al_get_bitmap_height(bmp);
+
+    // Queue the rectangle around the bitmap, 3.0 thick
+    sprite_batch_outline(&presents_batch, rect.x - tx, rect.y - ty, rect.x - tx + bitmap_width, rect.y - ty + bitmap_height, outline_color, 3.0);
+}
+
+// queue the world images on the asset manager
+void add_world_assets(AssetManager* assets) {
+    good_icons_asset = add_bitmap_asset(assets, "DATA/Gfxs/ChristmasIcons.png");
+    evil_icons_asset = add_bitmap_asset(assets, "DATA/Gfxs/BogeymanIcons.png");
+    sledge_asset = add_bitmap_asset(assets, "DATA/Gfxs/santaSledge.png");
+}
+
+// draw the loading bar, called on the display thread each time an asset is loaded
+void draw_loading_progress(int nb_done, int nb_assets, const Asset* asset, void* user_data) {
+    (void)user_data;
+    n_log(LOG_DEBUG, "loaded %s, %d/%d", asset->filename, nb_done, nb_assets);
+
+    float bar_x = WIDTH / 4.0f;
+    float bar_y = HEIGHT / 2.0f;
+    float bar_w = WIDTH / 2.0f;
+    al_clear_to_color(al_map_rgb(0, 0, 0));
+    al_draw_filled_rectangle(bar_x, bar_y - 10, bar_x + bar_w * nb_done / nb_assets, bar_y + 10, al_map_rgb(200, 0, 0));
+    al_draw_rectangle(bar_x, bar_y - 10, bar_x + bar_w, bar_y + 10, al_map_rgb(255, 255, 255), 2.0);
+    al_flip_display();
+}
+
+// cut the loaded presents and sledge images, place the presents and set up particles
+int init_world(AssetManager* assets) {
+    int GRID_SIZE = 3;
+    int ICON_SIZE = 84;
+
+    // Get the PNG file containing the christmas icons
+    png_good = asset_bitmap(assets, good_icons_asset);
+    if (!png_good) {
+        fprintf(stderr, "Failed to load ChristmasIcons PNG file.\n");
+        return -1;
+    }
+    // Loop through the grid (4x4) and extract each icon (64x64 pixels)
+    for (int i = 0; i < GRID_SIZE; i++) {
+        for (int j = 0; j < GRID_SIZE; j++) {
+            // Calculate the position of the current icon in the PNG
+            int x = j * ICON_SIZE;
+            int y = i * ICON_SIZE;
+
+            // Extract the icon and store it in the iconlist array
+            christmasPresents[i * GRID_SIZE + j] = al_create_sub_bitmap(png_good, x, y, ICON_SIZE, ICON_SIZE);
+            if (!christmasPresents[i * GRID_SIZE + j]) {
+                fprintf(stderr, "Failed to create sub bitmap.\n");
+                return -1;
+            }
+            if (!build_collision_mask(&christmas_masks[i * GRID_SIZE + j], christmasPresents[i * GRID_SIZE + j], COLLISION_MASK_ALPHA)) {
+                fprintf(stderr, "Failed to build collision mask.\n");
+                return -1;
+            }
+        }
+    }
+    int nb_good_icons = GRID_SIZE * GRID_SIZE;
+    int good_icon_size = ICON_SIZE;
+
+    // Get the PNG file containing the bogeyman icons
+    GRID_SIZE = 4;
+    ICON_SIZE = 128;
+    png_evil = asset_bitmap(assets, evil_icons_asset);
+    if (!png_evil) {
+        fprintf(stderr, "Failed to load BogeymanIcons PNG file.\n");
+        return -1;
+    }
+    // Loop through the grid (4x4) and extract each icon (64x64 pixels)
+    for (int i = 0; i < GRID_SIZE; i++) {
+        for (int j = 0; j < GRID_SIZE; j++) {
+            // Calculate the position of the current icon in the PNG
+            int x = j * ICON_SIZE;
+            int y = i * ICON_SIZE;
+
+            // Extract the icon and store it in the iconlist array
+            bogeymanPresents[i * GRID_SIZE + j] = al_create_sub_bitmap(png_evil, x, y, ICON_SIZE, ICON_SIZE);
+            if (!bogeymanPresents[i * GRID_SIZE + j]) {
+                fprintf(stderr, "Failed to create sub bitmap.\n");
+                return -1;
+            }
+            if (!build_collision_mask(&bogeyman_masks[i * GRID_SIZE + j], bogeymanPresents[i * GRID_SIZE + j], COLLISION_MASK_ALPHA)) {
+                fprintf(stderr, "Failed to build collision mask.\n");
+                return -1;
+            }
+        }
+    }
+    // spread gifts and Krampus items over the world, with room for the largest icon between them
+    int nb_objects = nb_good_presents + nb_bad_presents;
+    Vector* spots = NULL;
+    Malloc(spots, Vector, nb_objects);
+    __n_assert(spots, n_log(LOG_ERR, "could not allocate %d object positions", nb_objects); exit(1););
+    double spacing = 1 + (good_icon_size > ICON_SIZE ? good_icon_size : ICON_SIZE);
+    int nb_spots = jittered_grid_sampling(-world_width / 2.0, -world_height / 2.0, world_width, world_height, spacing, nb_objects, spots);
+    if (nb_spots < nb_objects)
+        n_log(LOG_ERR, "only %d objects could be placed in a %ldx%ld world", nb_spots, world_width, world_height);
+
+    // init good presents LIST
+    good_presents = new_generic_list(-1);
+    int spot = 0;
+    for (int it = 0; it < nb_good_presents && spot < nb_spots; it++, spot++) {
+        gift_dash_object* object = NULL;
+        Malloc(object, gift_dash_object, 1);
+        object->type = good;
+        object->id = game_rand(RANDOM_WORLD) % nb_good_icons;
+        object->rect.w = good_icon_size;
+        object->rect.h = good_icon_size;
+        object->rect.x = (int)(spots[spot].x - good_icon_size / 2);
+        object->rect.y = (int)(spots[spot].y - good_icon_size / 2);
+        list_push(good_presents, object, free);
+    }
+
+    // init bad presents LIST
+    bad_presents = new_generic_list(-1);
+    for (int it = 0; it < nb_bad_presents && spot < nb_spots; it++, spot++) {
+        gift_dash_object* object = NULL;
+        Malloc(object, gift_dash_object, 1);
+        object->type = evil;
+        object->id = game_rand(RANDOM_WORLD) % (GRID_SIZE * GRID_SIZE);
+        object->rect.w = ICON_SIZE;
+        object->rect.h = ICON_SIZE;
+        object->rect.x = (int)(spots[spot].x - ICON_SIZE / 2);
+        object->rect.y = (int)(spots[spot].y - ICON_SIZE / 2);
+        list_push(bad_presents, object, free);
+    }
+    Free(spots);
+
+    init_sprite_batch(&presents_batch);
+
+    // presents never move: index them once
+    if (!build_presents_grid(&good_presents_grid, good_presents) || !build_presents_grid(&bad_presents_grid, bad_presents)) {
+        n_log(LOG_ERR, "could not build presents grids");
+        exit(1);
+    }
+
+    __n_assert((santaSledgebmp = asset_bitmap(assets, sledge_asset)), n_log(LOG_ERR, "DATA/Gfxs/santaSledge.png is not loaded"); exit(1););
+    if (!build_collision_mask(&sledge_mask, santaSledgebmp, COLLISION_MASK_ALPHA)) {
+        fprintf(stderr, "Failed to build collision mask.\n");
+        return -1;
+    }
+
+    init_vehicle(&santaSledge, WIDTH / 2, HEIGHT / 2);
+    set_vehicle_properties(&santaSledge, 2.0, 45.0, 75.0, 1.5);
+
+    init_particle_system(&particle_system, MAX_PARTICLES, 0, 0, 0, 100);
+    reserve_particles(particle_system, 65536);
+    seed_particle_system(particle_system, game_rand(RANDOM_PARTICLES));
+
+    // ambient snow goes first, gameplay hints last. Headless runs have no frame to fit in and replays must emit the
+    // same particles on every run whatever the machine: both stay at full budget and only the caps apply
+    init_particle_governor(&particle_governor, particle_system, (headless || journal_replaying) ? 0.0 : PARTICLE_FRAME_BUDGET * 1000000.0 / drawFPS);
+    snow_particles = add_particle_category(&particle_governor, 0, 0.0, 2);
+    krampus_particles = add_particle_category(&particle_governor, 1, 0.1, 256);
+    fireworks_particles = add_particle_category(&particle_governor, 1, 0.1, 200);
+    trail_particles = add_particle_category(&particle_governor, 2, 0.0, 6);
+    target_particles = add_particle_category(&particle_governor, 3, 1.0, 3);
+    burst_particles = add_particle_category(&particle_governor, 3, 0.25, 1000);
+
+    // bursts emitters: gift pickup, Krampus collision and win fireworks
+    memset(&gift_burst, 0, sizeof(PARTICLE_EMITTER));
+    gift_burst.spr_id = -1;
+    gift_burst.mode = PIXEL_PART;
+    gift_burst.lifetime = 700000;
+    gift_burst.size = 1;
+    gift_burst.size_range = 6;
+    gift_burst.color = al_map_rgba(0, 0, 0, 50);
+    gift_burst.color_range = al_map_rgba(254, 254, 254, 199);
+    gift_burst.object.type = 1;
+    VECTOR3D_SET(gift_burst.object.speed, -0.5, -0.5, 0.0);
+    VECTOR3D_SET(gift_burst.speed_range, 1.0, 1.0, 0.0);
+
+    memcpy(&krampus_burst, &gift_burst, sizeof(PARTICLE_EMITTER));
+    krampus_burst.color_range = al_map_rgba(0, 0, 0, 199);
+
+    memcpy(&win_burst, &gift_burst, sizeof(PARTICLE_EMITTER));
+    win_burst.lifetime = 500000;
+    win_burst.lifetime_range = 499999;
+    win_burst.size_range = 2;
+    win_burst.color = al_map_rgb(55, 55, 55);
+    win_burst.color_range = al_map_rgba(199, 199, 199, 0);
+
+    return 0;
+}
+
+// pack a keys array in a mask, one bit per key
+uint32_t keys_to_mask(const int* keys) {
+    uint32_t mask = 0;
+    for (int it = 0; it < (int)(sizeof(key) / sizeof(key[0])); it++) {
+        if (keys[it])
+            mask |= (1U << it);
+    }
+    return mask;
+}
+
+// record the keys of the tick, or replace them by the recorded ones. ESC always comes from the keyboard
+void journal_inputs(void) {
+    if (journal_replaying) {
+        uint32_t mask = 0;
+        if (!replay_input_tick(&input_journal, &mask)) {
+            n_log(LOG_NOTICE, "end of input journal after %u ticks", input_journal.ticks);
+            journal_replaying = 0;
+            journal_replay_ended = 1;
+            DONE = 1;
+            return;
+        }
+        for (int it = 0; it < (int)(sizeof(key) / sizeof(key[0])); it++) {
+            if (it != KEY_ESC)
+                key[it] = (mask >> it) & 1;
+        }
+    } else if (journal_recording) {
+        record_input_tick(&input_journal, keys_to_mask(key));
+    }
+}
+
+// run one logic step: inputs, sledge, particles, collisions and game timer. Returns its duration in usecs
+time_t logic_tick(void) {
+    journal_inputs();
+    start_HiTimer(&logic_chrono);
+    N_PROFILE_BEGIN(logic);
+    N_PROFILE_BEGIN(input);
+    // Processing inputs
+    // get_keyboard( chat_line , ev );
+    if (key[KEY_F1]) {
+        set_vehicle_properties(&santaSledge, 2.0, 45.0, 75.0, 1.5);
+    }
+    if (key[KEY_F2]) {
+        set_vehicle_properties(&santaSledge, 4.0, 60.0, 100.0, 1.0);
+    }
+    if (key[KEY_F3]) {
+        set_vehicle_properties(&santaSledge, 6.0, 90.0, 150.0, 0.5);
+    }
+    if (key[KEY_F4]) {
+    }
+    if (key[KEY_F5]) {
+    }
+    if (key[KEY_F6]) {
+    }
+    set_handbrake(&santaSledge, 0.0);
+    if (key[KEY_LEFT] && fabs(santaSledge.speed) > 0) {
+        steer_vehicle(&santaSledge, -2.0);
+        if (key[KEY_SPACE]) {
+            set_handbrake(&santaSledge, 1.0);
+        }
+    } else if (key[KEY_RIGHT] && fabs(santaSledge.speed) > 0) {
+        steer_vehicle(&santaSledge, 2.0);
+        if (key[KEY_SPACE]) {
+            set_handbrake(&santaSledge, -1.0);
+        }
+    } else if (key[KEY_SPACE]) {
+        brake_vehicle(&santaSledge, 1.0 / logicFPS);
+    }
+
+    if (key[KEY_UP]) {
+        intro_text_scroll_enable = 0;
+        if (santaSledge.handbrake == 0)
+            accelerate_vehicle(&santaSledge, 1.0 / logicFPS);
+    } else {
+        if (santaSledge.speed <= 30)
+            santaSledge.speed = 0;
+    }
+    if (key[KEY_DOWN]) {
+        brake_vehicle(&santaSledge, 1.0 / logicFPS);
+    }
+
+    if (key[KEY_PAD_PLUS]) {
+    }
+    if (key[KEY_PAD_MINUS]) {
+    }
+    if (mouse_button) {
+        // n_log( LOG_DEBUG , "mouse button: %d" , mouse_button );
+    }
+    N_PROFILE_END(input);
+
+    N_PROFILE_BEGIN(particles);
+    // a new emission period: particles cost of a displayed frame, from the last update and drawing
+    update_particle_governor(&particle_governor, particle_update_usec * logicFPS / drawFPS + __atomic_load_n(&particle_draw_usec, __ATOMIC_RELAXED));
+
+    double x1 = 0, y1 = 0, x2 = 0, y2 = 0;
+    calculate_perpendicular_points(santaSledge.x, santaSledge.y, santaSledge.direction, 20.0, &x1, &y1, &x2, &y2);
+
+    PHYSICS tmp_part;
+    memset(&tmp_part, 0, sizeof(PHYSICS));
+    tmp_part.type = 1;
+    VECTOR3D_SET(tmp_part.speed, 0.0, 0.0, 0.0);
+
+    if (santaSledge.handbrake) {
+        // red, green and blue on each side
+        int count = particle_governor_emit(&particle_governor, trail_particles, 6);
+        for (int it = 0; it < count; it++) {
+            double x = (it < 3) ? x1 : x2;
+            double y = (it < 3) ? y1 : y2;
+            VECTOR3D_SET(tmp_part.position, x + 2 - game_rand(RANDOM_PARTICLES) % 4, y + 2 - game_rand(RANDOM_PARTICLES) % 4, 0.0);
+            if (it % 3 == 0)
+                add_particle(particle_system, -1, PIXEL_PART, 60000000, 1 + game_rand(RANDOM_PARTICLES) % 3, al_map_rgb(55 + game_rand(RANDOM_PARTICLES) % 200, 0, 0), tmp_part);
+            else if (it % 3 == 1)
+                add_particle(particle_system, -1, PIXEL_PART, 60000000, 1 + game_rand(RANDOM_PARTICLES) % 3, al_map_rgb(0, 55 + game_rand(RANDOM_PARTICLES) % 200, 0), tmp_part);
+            else
+                add_particle(particle_system, -1, PIXEL_PART, 60000000, 1 + game_rand(RANDOM_PARTICLES) % 3, al_map_rgb(0, 0, 55 + game_rand(RANDOM_PARTICLES) % 200), tmp_part);
+        }
+    } else if (santaSledge.speed > 0) {
+        // two greys on each side
+        int count = particle_governor_emit(&particle_governor, trail_particles, 4);
+        int grey_value = (count > 0) ? 50 + game_rand(RANDOM_PARTICLES) % 100 : 0;
+        for (int it = 0; it < count; it++) {
+            double x = (it < 2) ? x1 : x2;
+            double y = (it < 2) ? y1 : y2;
+            VECTOR3D_SET(tmp_part.position, x + 2 - game_rand(RANDOM_PARTICLES) % 4, y + 2 - game_rand(RANDOM_PARTICLES) % 4, 0.0);
+            add_particle(particle_system, -1, PIXEL_PART, 60000000, 1 + game_rand(RANDOM_PARTICLES) % 3, al_map_rgb(grey_value, grey_value, grey_value), tmp_part);
+        }
+    }
+    // particles on good things
+    // list_foreach(node, good_presents) {
+    //    gift_dash_object* object = node->ptr;
+    //
+
+    // particles on good target
+    if (good_presents->start) {
+        gift_dash_object* object = good_presents->start->ptr;
+        VECTOR3D_SET(tmp_part.position, object->rect.x + object->rect.w / 2, object->rect.y + object->rect.h / 2, 0.0);
+        int count = particle_governor_emit(&particle_governor, target_particles, 3);
+        for (int it = 0; it < count; it++) {
+            VECTOR3D_SET(tmp_part.speed, (-5.0 + game_rand(RANDOM_PARTICLES) % 11) / 80.0, (-5.0 + game_rand(RANDOM_PARTICLES) % 11) / 80.0, 0.0);
+            if (it == 0)
+                add_particle(particle_system, -1, PIXEL_PART, 900000, 1 + game_rand(RANDOM_PARTICLES) % 7, al_map_rgba(55 + game_rand(RANDOM_PARTICLES) % 200, 0, 0, 50 + game_rand(RANDOM_PARTICLES) % 200), tmp_part);
+            else if (it == 1)
+                add_particle(particle_system, -1, PIXEL_PART, 900000, 1 + game_rand(RANDOM_PARTICLES) % 7, al_map_rgba(0, 55 + game_rand(RANDOM_PARTICLES) % 200, 0, 50 + game_rand(RANDOM_PARTICLES) % 200), tmp_part);
+            else
+                add_particle(particle_system, -1, PIXEL_PART, 900000, 1 + game_rand(RANDOM_PARTICLES) % 7, al_map_rgba(0, 0, 55 + game_rand(RANDOM_PARTICLES) % 200, 50 + game_rand(RANDOM_PARTICLES) % 200), tmp_part);
+        }
+    }
+
+    // particles on bad things. When throttled, the items showing one are spread evenly and rotate on each tick.
+    // They are taken from the grid arrays, indexed like the list, so only the selected items are visited
+    int nb_bad_items = bad_presents_grid.nb_objects;
+    int krampus_count = particle_governor_emit(&particle_governor, krampus_particles, nb_bad_items);
+    if (krampus_count > 0) {
+        long int phase = krampus_particles_phase++;
+        for (long int slot = 0; slot < krampus_count; slot++) {
+            long int index = (phase + slot * nb_bad_items / krampus_count) % nb_bad_items;
+            if (!bad_presents_grid.objects[index])
+                continue;
+            CollisionRectangle* rect = &bad_presents_grid.rects[index];
+            VECTOR3D_SET(tmp_part.position, rect->x + rect->w / 2, rect->y + rect->h / 2, 0.0);
+            VECTOR3D_SET(tmp_part.speed, (-5.0 + game_rand(RANDOM_PARTICLES) % 11) / 50.0, (-5.0 + game_rand(RANDOM_PARTICLES) % 11) / 50.0, 0.0);
+            add_particle(particle_system, -1, PIXEL_PART, 600000, 1 + game_rand(RANDOM_PARTICLES) % 7, al_map_rgba(0, 0, 0, 50 + game_rand(RANDOM_PARTICLES) % 200), tmp_part);
+        }
+    }
+
+    start_HiTimer(&particle_chrono);
+    if (particle_thread_threshold > 0 && particle_system->nb_particles >= particle_thread_threshold)
+        manage_particle_threaded(particle_system, thread_pool, 1000000000 / logicFPS);
+    else
+        manage_particle_ex(particle_system, 1000000000 / logicFPS);
+    particle_update_usec = get_usec(&particle_chrono);
+    N_PROFILE_END(particles);
+
+    N_PROFILE_BEGIN(vehicle);
+    long int previous_x = santaSledge.x;
+    long int previous_y = santaSledge.y;
+    // pose the collisions are swept from, so that fast moves cannot jump over an item
+    double sweep_x = santaSledge.x, sweep_y = santaSledge.y, sweep_direction = santaSledge.direction;
+    update_vehicle(&santaSledge, 1.0 / logicFPS);
+    // print_vehicle(&santaSledge);
+
+    // wrap one screen away from the world borders
+    bool wrapped = false;
+    if (santaSledge.x < -(world_width / 2 + WIDTH)) {
+        santaSledge.x = world_width / 2 + WIDTH;
+        wrapped = true;
+    }
+    if (santaSledge.x > world_width / 2 + WIDTH) {
+        santaSledge.x = -(world_width / 2 + WIDTH);
+        wrapped = true;
+    }
+    if (santaSledge.y < -(world_height / 2 + HEIGHT)) {
+        santaSledge.y = world_height / 2 + HEIGHT;
+        wrapped = true;
+    }
+    if (santaSledge.y > world_height / 2 + HEIGHT) {
+        santaSledge.y = -(world_height / 2 + HEIGHT);
+        wrapped = true;
+    }
+    if (wrapped) {
+        // nothing to sweep across the world
+        sweep_x = santaSledge.x;
+        sweep_y = santaSledge.y;
+        sweep_direction = santaSledge.direction;
+    }
+    N_PROFILE_END(vehicle);
+
+    N_PROFILE_BEGIN(collision);
+    // sledge move, computed once for all the items it is tested against
+    CollisionShape sledge_shape;
+    set_collision_shape(&sledge_shape, santaSledgebmp, 0, al_get_bitmap_height(santaSledgebmp) / 2.0, sweep_x, sweep_y, DEG_TO_RAD(sweep_direction), santaSledge.x, santaSledge.y, DEG_TO_RAD(santaSledge.direction));
+    // Check collision with the target
+    if (good_presents->start) {
+        gift_dash_object* target_item = good_presents->start->ptr;
+        double impact = collision_shape_impact(&sledge_shape, target_item->rect);
+        // boxes touching, then solid pixels touching
+        if (impact >= 0.0 && sledge_item_impact(sweep_x, sweep_y, sweep_direction, impact, &christmas_masks[target_item->id], target_item->rect) >= 0.0) {
+            target_item = remove_list_node(good_presents, good_presents->start, gift_dash_object);
+            remove_from_collision_grid(&good_presents_grid, target_item->grid_index);
+            // add bad particles for collision
+            VECTOR3D_SET(gift_burst.object.position, target_item->rect.x + target_item->rect.w / 2, target_item->rect.y + target_item->rect.h / 2, 0.0);
+            add_particles_batch(particle_system, particle_governor_emit(&particle_governor, burst_particles, 200), &gift_burst);
+            free(target_item);
+            // add more time
+            max_time += 15000000;
+        }
+    } else  // no start ? all collected, it's a win !
+    {
+        // the outro length is counted in ticks, so replays and headless runs end it on the same tick as the recording
+        if (outro_ticks < 0)
+            outro_ticks = (long int)ceil((HEIGHT + OUTRO_LINES * OUTRO_LINE_HEIGHT) / OUTRO_SCROLL_SPEED * logicFPS);
+        if (outro_ticks > 0) {
+            outro_ticks--;
+            VECTOR3D_SET(win_burst.object.position, (-world_width / 2) + game_rand(RANDOM_PARTICLES) % (world_width - 64), (-world_height / 2) + game_rand(RANDOM_PARTICLES) % (world_height - 64), 0.0);
+            add_particles_batch(particle_system, particle_governor_emit(&particle_governor, fireworks_particles, 200), &win_burst);
+        } else if (bad_presents->nb_items > 0) {
+            // outro over: free ride
+            list_empty(bad_presents);
+            clear_collision_grid(&bad_presents_grid);
+        }
+    }
+
+    // Check collision with the evil items in the cells around the sledge move
+    void* candidates[MAX_COLLISION_CANDIDATES];
+    CollisionRectangle candidate_rects[MAX_COLLISION_CANDIDATES];
+    int nb_candidates = query_collision_grid(&bad_presents_grid, sledge_shape.bounds, candidates, MAX_COLLISION_CANDIDATES);
+    if (nb_candidates > MAX_COLLISION_CANDIDATES) {
+        n_log(LOG_ERR, "%d evil items around the sledge, only the first %d are tested", nb_candidates, MAX_COLLISION_CANDIDATES);
+        nb_candidates = MAX_COLLISION_CANDIDATES;
+    }
+    for (int it = 0; it < nb_candidates; it++)
+        candidate_rects[it] = ((gift_dash_object*)candidates[it])->rect;
+    int hit = -1;
+    double impact = 0.0;
+    while ((hit = collision_shape_first_hit(&sledge_shape, candidate_rects, nb_candidates, hit + 1, &impact)) >= 0) {
+        gift_dash_object* item = candidates[hit];
+        // boxes touching, skip the item if no solid pixels do
+        if (sledge_item_impact(sweep_x, sweep_y, sweep_direction, impact, &bogeyman_masks[item->id], item->rect) < 0.0)
+            continue;
+        santaSledge.x = previous_x;
+        santaSledge.y = previous_y;
+        santaSledge.speed = -santaSledge.speed / 2;
+        update_vehicle(&santaSledge, 1.0 / logicFPS);
+        // add bad particles for collision
+        VECTOR3D_SET(krampus_burst.object.position, item->rect.x + item->rect.w / 2, item->rect.y + item->rect.h / 2, 0.0);
+        add_particles_batch(particle_system, particle_governor_emit(&particle_governor, burst_particles, 200), &krampus_burst);
+        // the next candidates are tested against the bounced move
+        set_collision_shape(&sledge_shape, santaSledgebmp, 0, al_get_bitmap_height(santaSledgebmp) / 2.0, sweep_x, sweep_y, DEG_TO_RAD(sweep_direction), santaSledge.x, santaSledge.y, DEG_TO_RAD(santaSledge.direction));
+    }
+    N_PROFILE_END(collision);
+
+    // add snow
+    int snow_count = particle_governor_emit(&particle_governor, snow_particles, 2);
+    if (snow_count > 0) {
+        VECTOR3D_SET(tmp_part.position, (-world_width / 2) + game_rand(RANDOM_PARTICLES) % (world_width - 64), (-world_height / 2) + game_rand(RANDOM_PARTICLES) % (world_height - 64), 0.0);
+    }
+    for (int it = 0; it < snow_count; it++) {
+        VECTOR3D_SET(tmp_part.speed, (-2.0 + game_rand(RANDOM_PARTICLES) % 5) / 10.0, (game_rand(RANDOM_PARTICLES) % 11) / 10.0, 0.0);
+        add_particle(particle_system, -1, SINUS_PART, 3000000, 1 + game_rand(RANDOM_PARTICLES) % 3, al_map_rgba(255, 255, 100 + game_rand(RANDOM_PARTICLES) % 50, 50 + game_rand(RANDOM_PARTICLES) % 50), tmp_part);
+    }
+
+    N_PROFILE_END(logic);
+    time_t tick_duration = get_usec(&logic_chrono);
+
+    max_time -= 1000000 / logicFPS;
+    if (max_time <= 0) {
+        max_time = 0;
+        DONE = 1;
+    }
+
+    return tick_duration;
+}
+
+// headless autopilot: steer toward the current gift, braking when it is off course, with some random handbrake turns.
+// After bouncing on a Krampus item it turns a random way for half a second
+void headless_input(void) {
+    static int avoid_ticks = 0;
+    static int avoid_key = KEY_LEFT;
+
+    key[KEY_UP] = 1;
+    key[KEY_DOWN] = key[KEY_LEFT] = key[KEY_RIGHT] = 0;
+    key[KEY_SPACE] = (game_rand(RANDOM_AUTOPILOT) % 100) < 2;
+    if (santaSledge.speed < 0 && avoid_ticks == 0) {
+        avoid_ticks = logicFPS / 2;
+        avoid_key = (game_rand(RANDOM_AUTOPILOT) % 2) ? KEY_LEFT : KEY_RIGHT;
+    }
+    if (avoid_ticks > 0) {
+        avoid_ticks--;
+        key[avoid_key] = 1;
+    } else if (good_presents->start) {
+        gift_dash_object* target = good_presents->start->ptr;
+        double angle = atan2(target->rect.y + target->rect.h / 2 - santaSledge.y, target->rect.x + target->rect.w / 2 - santaSledge.x) * 180.0 / M_PI;
+        double diff = fmod(angle - santaSledge.direction + 540.0, 360.0) - 180.0;
+        if (diff < -5.0)
+            key[KEY_LEFT] = 1;
+        else if (diff > 5.0)
+            key[KEY_RIGHT] = 1;
+        if (fabs(diff) > 45.0 && santaSledge.speed > 400.0) {
+            key[KEY_UP] = 0;
+            key[KEY_DOWN] = 1;
+        }
+    }
+}
+
+// copy what the display thread draws into the back snapshot and publish it. tick_time is when the last tick was due
+void publish_world(double tick_time) {
+    N_PROFILE_BEGIN(snapshot);
+    WorldSnapshot* snapshot = snapshot_back(&world_snapshots);
+
+    snapshot->sledge = santaSledge;
+    snapshot->previous_x = previous_sledge_x;
+    snapshot->previous_y = previous_sledge_y;
+    snapshot->previous_direction = previous_sledge_direction;
+    snapshot->tick_time = tick_time;
+    snapshot->has_target = (good_presents->start != NULL);
+    if (snapshot->has_target) {
+        gift_dash_object* target_item = good_presents->start->ptr;
+        snapshot->target = target_item->rect;
+    }
+    snapshot->nb_good_presents = good_presents->nb_items;
+    snapshot->nb_bad_presents = bad_presents->nb_items;
+    snapshot->max_time = max_time;
+    snapshot->done = DONE;
+    snapshot->intro_scrolling = intro_text_scroll_enable;
+
+    // cameras between the previous and the current sledge position, or only the current one across a world wrap
+    double from_x = previous_sledge_x, from_y = previous_sledge_y;
+    if (fabs(santaSledge.x - from_x) >= WIDTH || fabs(santaSledge.y - from_y) >= HEIGHT) {
+        from_x = santaSledge.x;
+        from_y = santaSledge.y;
+    }
+    CollisionRectangle area = {fmin(from_x, santaSledge.x) - WIDTH / 2, fmin(from_y, santaSledge.y) - HEIGHT / 2,
+                               WIDTH + fabs(santaSledge.x - from_x), HEIGHT + fabs(santaSledge.y - from_y)};
+
+    // gifts first, then Krampus items, in drawing order
+    CollisionGrid* grids[2] = {&good_presents_grid, &bad_presents_grid};
+    void* found[MAX_VISIBLE_OBJECTS];
+    snapshot->nb_objects = 0;
+    for (int grid = 0; grid < 2; grid++) {
+        int nb_found = query_collision_grid(grids[grid], area, found, MAX_VISIBLE_OBJECTS);
+        if (nb_found > MAX_VISIBLE_OBJECTS) {
+            n_log(LOG_ERR, "%d objects in view, only the first %d are drawn", nb_found, MAX_VISIBLE_OBJECTS);
+            nb_found = MAX_VISIBLE_OBJECTS;
+        }
+        for (int it = 0; it < nb_found && snapshot->nb_objects < snapshot->max_objects; it++) {
+            gift_dash_object* object = found[it];
+            SnapshotObject* copy = &snapshot->objects[snapshot->nb_objects++];
+            copy->type = object->type;
+            copy->id = object->id;
+            copy->rect = object->rect;
+        }
+    }
+    copy_visible_particles(snapshot->particles, particle_system, area.x, area.y, area.w, area.h, 50);
+
+    publish_snapshot(&world_snapshots);
+    N_PROFILE_END(snapshot);
+}
+
+// logic thread: fixed step ticks paced on the clock, with the keys held in the display thread,
+// and a snapshot published after each batch of ticks
+void* logic_thread(void* param) {
+    (void)param;
+    double tick_seconds = 1.0 / logicFPS;
+    double next_tick = al_get_time() + tick_seconds;
+
+    while (!__atomic_load_n(&stop_logic, __ATOMIC_ACQUIRE) && !DONE) {
+        double now = al_get_time();
+        if (now < next_tick) {
+            al_rest(next_tick - now);
+            continue;
+        }
+        // too late to catch up: drop the time beyond MAX_CATCHUP_TICKS
+        if (now - next_tick > MAX_CATCHUP_TICKS * tick_seconds)
+            next_tick = now - MAX_CATCHUP_TICKS * tick_seconds;
+
+        while (next_tick <= now && !DONE) {
+            uint32_t mask = __atomic_load_n(&input_mask, __ATOMIC_ACQUIRE);
+            for (int it = 0; it < (int)(sizeof(key) / sizeof(key[0])); it++)
+                key[it] = (mask >> it) & 1;
+            previous_sledge_x = santaSledge.x;
+            previous_sledge_y = santaSledge.y;
+            previous_sledge_direction = santaSledge.direction;
+            logic_tick();
+            next_tick += tick_seconds;
+        }
+        publish_world(next_tick - tick_seconds);
+    }
+    return NULL;
+}
+
+// compare two tick durations for qsort
+int compare_durations(const void* a, const void* b) {
+    time_t da = *(const time_t*)a;
+    time_t db = *(const time_t*)b;
+    return (da > db) - (da < db);
+}
+
+// run headless_ticks logic ticks without display nor audio, then print the throughput and tick latency percentiles
+int run_headless(void) {
+    if (headless_ticks <= 0) {
+        n_log(LOG_ERR, "no tick to run");
+        return -1;
+    }
+    time_t* durations = NULL;
+    Malloc(durations, time_t, headless_ticks);
+    __n_assert(durations, return -1);
+
+    N_TIME run_chrono;
+    start_HiTimer(&run_chrono);
+    // the run goes on when the game timer expires, to keep the number of ticks constant
+    long int done_tick = -1;
+    for (long int tick = 0; tick < headless_ticks; tick++) {
+        // replayed inputs are set by logic_tick
+        if (!journal_replaying)
+            headless_input();
+        durations[tick] = logic_tick();
+        if (DONE && done_tick == -1)
+            done_tick = tick;
+    }
+    double elapsed = get_usec(&run_chrono) / 1000000.0;
+
+    qsort(durations, headless_ticks, sizeof(time_t), compare_durations);
+    printf("headless: %ld ticks in %.3f s, %.1f ticks/s\n", headless_ticks, elapsed, elapsed > 0 ? headless_ticks / elapsed : 0.0);
+    printf("tick latency (us): p50 %ld p95 %ld p99 %ld max %ld\n", (long)durations[headless_ticks * 50 / 100], (long)durations[headless_ticks * 95 / 100], (long)durations[headless_ticks * 99 / 100], (long)durations[headless_ticks - 1]);
+    printf("particles: %d, gifts left: %d", particle_system->nb_particles, good_presents->nb_items);
+    if (done_tick != -1)
+        printf(", time ran out at tick %ld", done_tick);
+    printf("\n");
+    for (int zone = 0; zone < n_profile_nb_zones(); zone++) {
+        N_PROFILE_STATS stats;
+        if (n_profile_get_stats(zone, &stats))
+            printf("zone %-10s (us): p50 %.1f p95 %.1f p99 %.1f max %.1f\n", stats.name, stats.p50 / 1000.0, stats.p95 / 1000.0, stats.p99 / 1000.0, stats.max / 1000.0);
+    }
+    Free(durations);
+
+    return 0;
+}
+
 int main(int argc, char* argv[]) {
     /* Set the locale to the POSIX C environment */
     setlocale(LC_ALL, "POSIX");
@@ -113,13 +893,26 @@ int main(int argc, char* argv[]) {
      */
     set_log_level(LOG_NOTICE);
 
-    if (load_app_state("app_config.json", &WIDTH, &HEIGHT, &fullscreen, &bgmusic,
-                       &drawFPS, &logicFPS) != TRUE) {
+    if (load_app_state("app_config.json", &WIDTH, &HEIGHT, &fullscreen, &playlist, &music_buffer_count, &music_buffer_samples,
+                       &drawFPS, &logicFPS, &particle_thread_threshold, &nb_good_presents, &nb_bad_presents,
+                       &world_width, &world_height) != TRUE) {
         n_log(LOG_ERR, "couldn't load app_config.json !");
         exit(1);
     }
+    if (world_width > 0 && world_width < MIN_WORLD_SIZE) {
+        n_log(LOG_ERR, "worldWidth %ld is below %d, using the default", world_width, MIN_WORLD_SIZE);
+        world_width = 0;
+    }
+    if (world_height > 0 && world_height < MIN_WORLD_SIZE) {
+        n_log(LOG_ERR, "worldHeight %ld is below %d, using the default", world_height, MIN_WORLD_SIZE);
+        world_height = 0;
+    }
+    if (world_width <= 0)
+        world_width = 6 * WIDTH;
+    if (world_height <= 0)
+        world_height = 6 * HEIGHT;
     n_log(LOG_DEBUG, "%s starting with params: %dx%d fullscreen(%d), music: %s",
-          argv[0], WIDTH, HEIGHT, fullscreen, _str(bgmusic));
+          argv[0], WIDTH, HEIGHT, fullscreen, _str(playlist ? playlist[0] : NULL));
 
     N_STR* log_file = NULL;
     nstrprintf(log_file, "%s.log", argv[0]);
@@ -128,14 +921,54 @@ int main(int argc, char* argv[]) {
 
     char ver_str[128] = "";
 
-    while ((getoptret = getopt(argc, argv, "hvV:L:")) != EOF) {
+    static struct option long_options[] = {
+        {"headless", no_argument, NULL, 'H'},
+        {"ticks", required_argument, NULL, 'T'},
+        {"seed", required_argument, NULL, 'S'},
+        {"record", required_argument, NULL, 'R'},
+        {"replay", required_argument, NULL, 'P'},
+        {"trace", required_argument, NULL, 'E'},
+        {"tsc", no_argument, NULL, 'C'},
+        {NULL, 0, NULL, 0}};
+
+    while ((getoptret = getopt_long(argc, argv, "hvV:L:", long_options, NULL)) != EOF) {
         switch (getoptret) {
             case 'h':
                 n_log(LOG_NOTICE,
                       "\n    %s -h help -v version -V DEBUGLEVEL "
-                      "(NOLOG,VERBOSE,NOTICE,ERROR,DEBUG)\n",
+                      "(NOLOG,VERBOSE,NOTICE,ERROR,DEBUG) -L logfile --headless --ticks N --seed S --record FILE --replay FILE --trace FILE --tsc\n",
                       argv[0]);
                 exit(TRUE);
+            case 'H':
+                headless = 1;
+                break;
+            case 'T':
+                headless_ticks = strtol(optarg, NULL, 10);
+                if (headless_ticks <= 0) {
+                    n_log(LOG_ERR, "%s is not a valid number of ticks", optarg);
+                    exit(FALSE);
+                }
+                headless_ticks_set = 1;
+                break;
+            case 'S':
+                game_seed = strtoull(optarg, NULL, 10);
+                break;
+            case 'R':
+                journal_file = optarg;
+                journal_recording = 1;
+                break;
+            case 'P':
+                journal_file = optarg;
+                journal_replaying = 1;
+                break;
+            case 'E':
+                trace_file = optarg;
+                break;
+            case 'C':
+                // timers on the calibrated time stamp counter, monotonic clock if unavailable
+                if (set_time_source(N_TIME_CLOCK_TSC) != TRUE)
+                    n_log(LOG_ERR, "time stamp counter unavailable, using the monotonic clock");
+                break;
             case 'v':
                 sprintf(ver_str, "%s %s", __DATE__, __TIME__);
                 exit(TRUE);
@@ -187,16 +1020,85 @@ int main(int argc, char* argv[]) {
             default:
                 n_log(LOG_ERR,
                       "\n    %s -h help -v version -V DEBUGLEVEL "
-                      "(NOLOG,VERBOSE,NOTICE,ERROR,DEBUG) -L logfile",
+                      "(NOLOG,VERBOSE,NOTICE,ERROR,DEBUG) -L logfile --headless --ticks N --seed S --record FILE --replay FILE --trace FILE --tsc",
                       argv[0]);
                 exit(FALSE);
         }
     }
 
+    if (journal_recording && journal_replaying) {
+        n_log(LOG_ERR, "--record and --replay can not be used together");
+        exit(FALSE);
+    }
+    if (journal_replaying) {
+        // replays rebuild the recorded world, whatever the current settings
+        if (!open_input_journal_replay(&input_journal, journal_file))
+            exit(FALSE);
+        game_seed = input_journal.header.seed;
+        logicFPS = input_journal.header.logic_fps;
+        WIDTH = input_journal.header.width;
+        HEIGHT = input_journal.header.height;
+        nb_good_presents = input_journal.header.nb_good_presents;
+        nb_bad_presents = input_journal.header.nb_bad_presents;
+        world_width = input_journal.header.world_width;
+        world_height = input_journal.header.world_height;
+        if (world_width < MIN_WORLD_SIZE || world_height < MIN_WORLD_SIZE) {
+            n_log(LOG_ERR, "%s has a %ldx%ld world, below %d", journal_file, world_width, world_height, MIN_WORLD_SIZE);
+            exit(FALSE);
+        }
+        if (!headless_ticks_set || headless_ticks > (long int)input_journal.header.nb_ticks)
+            headless_ticks = input_journal.header.nb_ticks;
+        n_log(LOG_NOTICE, "replaying %s: %u ticks, seed %llu", journal_file, input_journal.header.nb_ticks, (unsigned long long)game_seed);
+    }
+    if (journal_recording) {
+        InputJournalHeader header;
+        memset(&header, 0, sizeof(InputJournalHeader));
+        header.seed = game_seed;
+        header.logic_fps = logicFPS;
+        header.width = WIDTH;
+        header.height = HEIGHT;
+        header.nb_good_presents = nb_good_presents;
+        header.nb_bad_presents = nb_bad_presents;
+        header.world_width = world_width;
+        header.world_height = world_height;
+        if (!open_input_journal_record(&input_journal, journal_file, &header))
+            exit(FALSE);
+    }
+    seed_game_random(game_seed);
+
     /* allegro 5 + addons loading */
     if (!al_init()) {
         n_abort("Could not init Allegro.\n");
     }
+
+    // assets are decoded on it before the particles use it
+    thread_pool = new_thread_pool(get_nb_cpu_cores(), 0);
+    n_log(LOG_INFO, "Starting %d threads", get_nb_cpu_cores());
+
+    AssetManager assets;
+
+    if (headless) {
+        // no display: bitmaps stay memory bitmaps, the logic only uses their sizes and collision masks
+        if (!al_init_image_addon()) {
+            n_abort("Unable to initialize image addon\n");
+        }
+        init_asset_manager(&assets, thread_pool, MAX_ASSETS, NULL, NULL);
+        add_world_assets(&assets);
+        start_asset_loading(&assets);
+        if (!wait_for_assets(&assets) || init_world(&assets) != 0) {
+            n_log(LOG_ERR, "could not initialize the world");
+            exit(1);
+        }
+        free_asset_manager(&assets);
+        int ret = run_headless();
+        if (trace_file)
+            n_profile_dump_trace(trace_file);
+        n_profile_free();
+        close_input_journal(&input_journal);
+        free_world_masks();
+        al_uninstall_system();
+        return ret;
+    }
     if (!al_init_acodec_addon()) {
         n_abort("Could not register addons.\n");
     }
@@ -253,9 +1155,21 @@ int main(int argc, char* argv[]) {
 
     al_set_window_title(display, "GiftDash");
 
-    ALLEGRO_FONT* little_font = al_load_font("DATA/2Dumb.ttf", 24, 0);
-    ALLEGRO_FONT* font = al_load_font("DATA/2Dumb.ttf", 48, 0);
-    ALLEGRO_FONT* big_font = al_load_font("DATA/2Dumb.ttf", 48, 0);
+    // every asset is decoded at once on the thread pool, the loading bar moving as they come in
+    init_asset_manager(&assets, thread_pool, MAX_ASSETS, draw_loading_progress, NULL);
+    int little_font_asset = add_font_asset(&assets, "DATA/2Dumb.ttf", 24);
+    int font_asset = add_font_asset(&assets, "DATA/2Dumb.ttf", 48);
+    int big_font_asset = add_font_asset(&assets, "DATA/2Dumb.ttf", 48);
+    add_world_assets(&assets);
+    start_asset_loading(&assets);
+    if (!wait_for_assets(&assets)) {
+        n_log(LOG_ERR, "could not load the assets");
+        exit(1);
+    }
+
+    ALLEGRO_FONT* little_font = asset_font(&assets, little_font_asset);
+    ALLEGRO_FONT* font = asset_font(&assets, font_asset);
+    ALLEGRO_FONT* big_font = asset_font(&assets, big_font_asset);
     // Game introduction text
     const char* intro_text[] = {
         "Welcome to Gift Dash !",
@@ -275,38 +1189,18 @@ int main(int argc, char* argv[]) {
         " ",
         "Good luck, KrampusHacker!"};
 
-    const char* outro_text[] = {
-        "WELL DONE ADVENTURER ! !",
-        " ",
-        "YOU GOT ALL THE PRESENTS BACK !",
-        " ",
-        "As a reward...",
-        " ",
-        "Enjoy the ride without any collision !",
-        " ",
-        "Thanks for playing :-)",
-        " ",
-        " ",
-        " ",
-        "GiftDash",
-        " ",
-        "KrampusHack 2024",
-        " ",
-        "By GullRaDriel"};
 
     int num_lines = sizeof(intro_text) / sizeof(intro_text[0]);
-    TextManager start_text_manager;
     init_text_manager(&start_text_manager, intro_text, num_lines, font, 80.0f, HEIGHT);  // 70 pixels per second
-    num_lines = sizeof(outro_text) / sizeof(outro_text[0]);
-    TextManager end_text_manager;
-    init_text_manager(&end_text_manager, outro_text, num_lines, big_font, 80.0f, HEIGHT);  // 70 pixels per second
+    init_text_manager(&end_text_manager, outro_text, OUTRO_LINES, big_font, OUTRO_SCROLL_SPEED, HEIGHT);
+
+    init_hud_field(&speed_hud, little_font, al_map_rgb(0, 0, 255), WIDTH, 10, ALLEGRO_ALIGN_RIGHT, "Speed: %d");
+    init_hud_field(&goodies_hud, little_font, al_map_rgb(0, 0, 255), 10, 10, ALLEGRO_ALIGN_LEFT, "Goodies to collect: %d");
+    init_hud_field(&time_hud, little_font, al_map_rgb(0, 0, 255), 10, 30, ALLEGRO_ALIGN_LEFT, "Time left: %d s");
 
     fps_timer = al_create_timer(1.0 / drawFPS);
-    logic_timer = al_create_timer(1.0 / logicFPS);
     al_start_timer(fps_timer);
-    al_start_timer(logic_timer);
     al_register_event_source(event_queue, al_get_timer_event_source(fps_timer));
-    al_register_event_source(event_queue, al_get_timer_event_source(logic_timer));
 
     al_register_event_source(event_queue, al_get_keyboard_event_source());
     al_register_event_source(event_queue, al_get_mouse_event_source());
@@ -317,139 +1211,18 @@ int main(int argc, char* argv[]) {
 
     al_hide_mouse_cursor(display);
 
-    int GRID_SIZE = 3;
-    int ICON_SIZE = 84;
-
-    // Load the PNG file containing the christmas icons
-    png_good = al_load_bitmap("DATA/Gfxs/ChristmasIcons.png");
-    if (!png_good) {
-        fprintf(stderr, "Failed to load ChristmasIcons PNG file.\n");
+    if (init_world(&assets) != 0) {
+        n_log(LOG_ERR, "could not initialize the world");
         return -1;
     }
-    // Loop through the grid (4x4) and extract each icon (64x64 pixels)
-    for (int i = 0; i < GRID_SIZE; i++) {
-        for (int j = 0; j < GRID_SIZE; j++) {
-            // Calculate the position of the current icon in the PNG
-            int x = j * ICON_SIZE;
-            int y = i * ICON_SIZE;
-
-            // Extract the icon and store it in the iconlist array
-            christmasPresents[i * GRID_SIZE + j] = al_create_sub_bitmap(png_good, x, y, ICON_SIZE, ICON_SIZE);
-            if (!christmasPresents[i * GRID_SIZE + j]) {
-                fprintf(stderr, "Failed to create sub bitmap.\n");
-                return -1;
-            }
-        }
-    }
-    // init good presents LIST
-    good_presents = new_generic_list(-1);
-    for (int it = 0; it < 25; it++) {
-        gift_dash_object* object = NULL;
-        Malloc(object, gift_dash_object, 1);
-        object->type = good;
-        object->id = rand() % (GRID_SIZE * GRID_SIZE);
-        object->rect.w = ICON_SIZE;
-        object->rect.h = ICON_SIZE;
-        bool collided = 0;
-        do {
-            collided = 0;
-            object->rect.x = (-3 * WIDTH) + rand() % ((6 * WIDTH) - 64);
-            object->rect.y = (-3 * HEIGHT) + rand() % ((6 * HEIGHT) - 64);
-            list_foreach(node, good_presents) {
-                gift_dash_object* item = node->ptr;
-                if ((object->rect.x + object->rect.w) >= item->rect.x &&
-                    object->rect.x <= (item->rect.x + item->rect.w) &&
-                    (object->rect.y + object->rect.h) >= item->rect.y &&
-                    object->rect.y <= (item->rect.y + item->rect.h)) {
-                    collided = 1;
-                    n_log(LOG_DEBUG, "%d,%d,%d,%d collided with %d,%d,%d,%d", object->rect.x, object->rect.y, object->rect.w, object->rect.h, item->rect.x, item->rect.y, item->rect.w, item->rect.h);
-                }
-            }
-        } while (collided == 1);
-        list_push(good_presents, object, free);
-    }
-
-    // Load the PNG file containing the bogeyman icons
-    GRID_SIZE = 4;
-    ICON_SIZE = 128;
-    png_evil = al_load_bitmap("DATA/Gfxs/BogeymanIcons.png");
-    if (!png_evil) {
-        fprintf(stderr, "Failed to load BogeymanIcons PNG file.\n");
-        return -1;
-    }
-    // Loop through the grid (4x4) and extract each icon (64x64 pixels)
-    for (int i = 0; i < GRID_SIZE; i++) {
-        for (int j = 0; j < GRID_SIZE; j++) {
-            // Calculate the position of the current icon in the PNG
-            int x = j * ICON_SIZE;
-            int y = i * ICON_SIZE;
+    free_asset_manager(&assets);
 
-            // Extract the icon and store it in the iconlist array
-            bogeymanPresents[i * GRID_SIZE + j] = al_create_sub_bitmap(png_evil, x, y, ICON_SIZE, ICON_SIZE);
-            if (!bogeymanPresents[i * GRID_SIZE + j]) {
-                fprintf(stderr, "Failed to create sub bitmap.\n");
-                return -1;
-            }
-        }
-    }
-    // init bad presents LIST
-    bad_presents = new_generic_list(-1);
-    for (int it = 0; it < 200; it++) {
-        gift_dash_object* object = NULL;
-        Malloc(object, gift_dash_object, 1);
-        object->type = evil;
-        object->id = rand() % (GRID_SIZE * GRID_SIZE);
-        object->rect.w = ICON_SIZE;
-        object->rect.h = ICON_SIZE;
-        bool collided = 0;
-        do {
-            collided = 0;
-            object->rect.x = (-3 * WIDTH) + rand() % ((6 * WIDTH) - 64);
-            object->rect.y = (-3 * HEIGHT) + rand() % ((6 * HEIGHT) - 64);
-            list_foreach(node, bad_presents) {
-                gift_dash_object* item = node->ptr;
-                if ((object->rect.x + object->rect.w) >= item->rect.x &&
-                    object->rect.x <= (item->rect.x + item->rect.w) &&
-                    (object->rect.y + object->rect.h) >= item->rect.y &&
-                    object->rect.y <= (item->rect.y + item->rect.h)) {
-                    collided = 1;
-                    n_log(LOG_DEBUG, "%d,%d,%d,%d collided with %d,%d,%d,%d", object->rect.x, object->rect.y, object->rect.w, object->rect.h, item->rect.x, item->rect.y, item->rect.w, item->rect.h);
-                }
-            }
-            list_foreach(node, good_presents) {
-                gift_dash_object* item = node->ptr;
-                if ((object->rect.x + object->rect.w) >= item->rect.x &&
-                    object->rect.x <= (item->rect.x + item->rect.w) &&
-                    (object->rect.y + object->rect.h) >= item->rect.y &&
-                    object->rect.y <= (item->rect.y + item->rect.h)) {
-                    collided = 1;
-                    n_log(LOG_DEBUG, "%d,%d,%d,%d collided with %d,%d,%d,%d", object->rect.x, object->rect.y, object->rect.w, object->rect.h, item->rect.x, item->rect.y, item->rect.w, item->rect.h);
-                }
-            }
-
-        } while (collided == 1);
-        list_push(bad_presents, object, free);
-    }
-
-    if (bgmusic) {
-        if (!(sample_data[0] = al_load_sample(bgmusic))) {
-            n_log(LOG_ERR, "Could not load %s", bgmusic);
-            exit(1);
-        }
-        al_play_sample(sample_data[0], 1, 0, 1, ALLEGRO_PLAYMODE_LOOP, NULL);
+    init_music_player(&music_player, playlist, music_buffer_count, music_buffer_samples);
+    if (music_player.nb_tracks > 0 && !start_music_player(&music_player)) {
+        n_log(LOG_ERR, "Could not stream any of the %d bg-music tracks", music_player.nb_tracks);
+        exit(1);
     }
 
-    __n_assert((santaSledgebmp = al_load_bitmap("DATA/Gfxs/santaSledge.png")), n_log(LOG_ERR, "load bitmap DATA/Gfxs/santaSledge.png returned null"); exit(1););
-
-    init_vehicle(&santaSledge, WIDTH / 2, HEIGHT / 2);
-    set_vehicle_properties(&santaSledge, 2.0, 45.0, 75.0, 1.5);
-
-    init_particle_system(&particle_system, INT_MAX, 0, 0, 0, 100);
-
-    thread_pool = new_thread_pool(get_nb_cpu_cores(), 0);
-
-    n_log(LOG_INFO, "Starting %d threads", get_nb_cpu_cores());
-
     al_flush_event_queue(event_queue);
     al_set_mouse_xy(display, WIDTH / 3, HEIGHT / 2);
 
@@ -458,8 +1231,24 @@ int main(int argc, char* argv[]) {
 
     bitmap = al_create_bitmap(WIDTH, HEIGHT);
 
+    if (!init_snapshot_buffer(&world_snapshots, 2 * MAX_VISIBLE_OBJECTS, 100)) {
+        n_log(LOG_ERR, "could not initialize the world snapshots");
+        return -1;
+    }
+
     DONE = 0;
+    previous_sledge_x = santaSledge.x;
+    previous_sledge_y = santaSledge.y;
+    previous_sledge_direction = santaSledge.direction;
+    publish_world(al_get_time());
+    pthread_t logic_thread_id;
+    if (pthread_create(&logic_thread_id, NULL, logic_thread, NULL) != 0) {
+        n_log(LOG_ERR, "could not start the logic thread");
+        return -1;
+    }
+    WorldSnapshot* snapshot = latest_snapshot(&world_snapshots);
     do {
+        N_PROFILE_BEGIN(events);
         // consume events
         do {
             ALLEGRO_EVENT ev;
@@ -469,63 +1258,67 @@ int main(int argc, char* argv[]) {
             if (ev.type == ALLEGRO_EVENT_KEY_DOWN) {
                 switch (ev.keyboard.keycode) {
                     case ALLEGRO_KEY_UP:
-                        key[KEY_UP] = 1;
+                        display_keys[KEY_UP] = 1;
                         break;
                     case ALLEGRO_KEY_DOWN:
-                        key[KEY_DOWN] = 1;
+                        display_keys[KEY_DOWN] = 1;
                         break;
                     case ALLEGRO_KEY_LEFT:
-                        key[KEY_LEFT] = 1;
+                        display_keys[KEY_LEFT] = 1;
                         break;
                     case ALLEGRO_KEY_RIGHT:
-                        key[KEY_RIGHT] = 1;
+                        display_keys[KEY_RIGHT] = 1;
                         break;
                     case ALLEGRO_KEY_ESCAPE:
-                        key[KEY_ESC] = 1;
+                        display_keys[KEY_ESC] = 1;
                         break;
                     case ALLEGRO_KEY_SPACE:
-                        key[KEY_SPACE] = 1;
+                        display_keys[KEY_SPACE] = 1;
                         break;
                     case ALLEGRO_KEY_LSHIFT:
                     case ALLEGRO_KEY_RSHIFT:
-                        key[KEY_SHIFT] = 1;
+                        display_keys[KEY_SHIFT] = 1;
                         break;
                     case ALLEGRO_KEY_PAD_MINUS:
-                        key[KEY_PAD_MINUS] = 1;
+                        display_keys[KEY_PAD_MINUS] = 1;
                         break;
                     case ALLEGRO_KEY_PAD_PLUS:
-                        key[KEY_PAD_PLUS] = 1;
+                        display_keys[KEY_PAD_PLUS] = 1;
                         break;
                     case ALLEGRO_KEY_PAD_ENTER:
-                        key[KEY_PAD_ENTER] = 1;
+                        display_keys[KEY_PAD_ENTER] = 1;
                         break;
                     case ALLEGRO_KEY_M:
-                        key[KEY_M] = 1;
+                        display_keys[KEY_M] = 1;
                         break;
                     case ALLEGRO_KEY_W:
-                        key[KEY_W] = 1;
+                        display_keys[KEY_W] = 1;
                         break;
                     case ALLEGRO_KEY_LCTRL:
                     case ALLEGRO_KEY_RCTRL:
-                        key[KEY_CTRL] = 1;
+                        display_keys[KEY_CTRL] = 1;
                         break;
                     case ALLEGRO_KEY_F1:
-                        key[KEY_F1] = 1;
+                        display_keys[KEY_F1] = 1;
                         break;
                     case ALLEGRO_KEY_F2:
-                        key[KEY_F2] = 1;
+                        display_keys[KEY_F2] = 1;
                         break;
                     case ALLEGRO_KEY_F3:
-                        key[KEY_F3] = 1;
+                        display_keys[KEY_F3] = 1;
                         break;
                     case ALLEGRO_KEY_F4:
-                        key[KEY_F4] = 1;
+                        display_keys[KEY_F4] = 1;
                         break;
                     case ALLEGRO_KEY_F5:
-                        key[KEY_F5] = 1;
+                        display_keys[KEY_F5] = 1;
                         break;
                     case ALLEGRO_KEY_F6:
-                        key[KEY_F6] = 1;
+                        display_keys[KEY_F6] = 1;
+                        break;
+                    case ALLEGRO_KEY_F9:
+                        // display side only, never seen by the logic nor journaled
+                        show_stats = !show_stats;
                         break;
                     default:
                         break;
@@ -533,63 +1326,63 @@ int main(int argc, char* argv[]) {
             } else if (ev.type == ALLEGRO_EVENT_KEY_UP) {
                 switch (ev.keyboard.keycode) {
                     case ALLEGRO_KEY_UP:
-                        key[KEY_UP] = 0;
+                        display_keys[KEY_UP] = 0;
                         break;
                     case ALLEGRO_KEY_DOWN:
-                        key[KEY_DOWN] = 0;
+                        display_keys[KEY_DOWN] = 0;
                         break;
                     case ALLEGRO_KEY_LEFT:
-                        key[KEY_LEFT] = 0;
+                        display_keys[KEY_LEFT] = 0;
                         break;
                     case ALLEGRO_KEY_RIGHT:
-                        key[KEY_RIGHT] = 0;
+                        display_keys[KEY_RIGHT] = 0;
                         break;
                     case ALLEGRO_KEY_ESCAPE:
-                        key[KEY_ESC] = 0;
+                        display_keys[KEY_ESC] = 0;
                         break;
                     case ALLEGRO_KEY_SPACE:
-                        key[KEY_SPACE] = 0;
+                        display_keys[KEY_SPACE] = 0;
                         break;
                     case ALLEGRO_KEY_LSHIFT:
                     case ALLEGRO_KEY_RSHIFT:
-                        key[KEY_SHIFT] = 0;
+                        display_keys[KEY_SHIFT] = 0;
                         break;
                     case ALLEGRO_KEY_PAD_MINUS:
-                        key[KEY_PAD_MINUS] = 0;
+                        display_keys[KEY_PAD_MINUS] = 0;
                         break;
                     case ALLEGRO_KEY_PAD_PLUS:
-                        key[KEY_PAD_PLUS] = 0;
+                        display_keys[KEY_PAD_PLUS] = 0;
                         break;
                     case ALLEGRO_KEY_PAD_ENTER:
-                        key[KEY_PAD_ENTER] = 0;
+                        display_keys[KEY_PAD_ENTER] = 0;
                         break;
                     case ALLEGRO_KEY_M:
-                        key[KEY_M] = 0;
+                        display_keys[KEY_M] = 0;
                         break;
                     case ALLEGRO_KEY_W:
-                        key[KEY_W] = 0;
+                        display_keys[KEY_W] = 0;
                         break;
                     case ALLEGRO_KEY_LCTRL:
                     case ALLEGRO_KEY_RCTRL:
-                        key[KEY_CTRL] = 0;
+                        display_keys[KEY_CTRL] = 0;
                         break;
                     case ALLEGRO_KEY_F1:
-                        key[KEY_F1] = 0;
+                        display_keys[KEY_F1] = 0;
                         break;
                     case ALLEGRO_KEY_F2:
-                        key[KEY_F2] = 0;
+                        display_keys[KEY_F2] = 0;
                         break;
                     case ALLEGRO_KEY_F3:
-                        key[KEY_F3] = 0;
+                        display_keys[KEY_F3] = 0;
                         break;
                     case ALLEGRO_KEY_F4:
-                        key[KEY_F4] = 0;
+                        display_keys[KEY_F4] = 0;
                         break;
                     case ALLEGRO_KEY_F5:
-                        key[KEY_F5] = 0;
+                        display_keys[KEY_F5] = 0;
                         break;
                     case ALLEGRO_KEY_F6:
-                        key[KEY_F6] = 0;
+                        display_keys[KEY_F6] = 0;
                         break;
 
                     default:
@@ -598,8 +1391,7 @@ int main(int argc, char* argv[]) {
             } else if (ev.type == ALLEGRO_EVENT_TIMER) {
                 if (al_get_timer_event_source(fps_timer) == ev.any.source) {
                     do_draw = 1;
-                } else if (al_get_timer_event_source(logic_timer) == ev.any.source) {
-                    do_logic = 1;
+                    update_music_player(&music_player);
                 }
             } else if (ev.type == ALLEGRO_EVENT_MOUSE_AXES) {
                 mx = ev.mouse.x;
@@ -629,210 +1421,37 @@ int main(int argc, char* argv[]) {
             }
         } while (!al_is_event_queue_empty(event_queue));
 
-        if (do_logic == 1) {
-            start_HiTimer(&logic_chrono);
-            // Processing inputs
-            // get_keyboard( chat_line , ev );
-            if (key[KEY_F1]) {
-                set_vehicle_properties(&santaSledge, 2.0, 45.0, 75.0, 1.5);
-            }
-            if (key[KEY_F2]) {
-                set_vehicle_properties(&santaSledge, 4.0, 60.0, 100.0, 1.0);
-            }
-            if (key[KEY_F3]) {
-                set_vehicle_properties(&santaSledge, 6.0, 90.0, 150.0, 0.5);
-            }
-            if (key[KEY_F4]) {
-            }
-            if (key[KEY_F5]) {
-            }
-            if (key[KEY_F6]) {
-            }
-            set_handbrake(&santaSledge, 0.0);
-            if (key[KEY_LEFT] && fabs(santaSledge.speed) > 0) {
-                steer_vehicle(&santaSledge, -2.0);
-                if (key[KEY_SPACE]) {
-                    set_handbrake(&santaSledge, 1.0);
-                }
-            } else if (key[KEY_RIGHT] && fabs(santaSledge.speed) > 0) {
-                steer_vehicle(&santaSledge, 2.0);
-                if (key[KEY_SPACE]) {
-                    set_handbrake(&santaSledge, -1.0);
-                }
-            } else if (key[KEY_SPACE]) {
-                brake_vehicle(&santaSledge, 1.0 / logicFPS);
-            }
-
-            if (key[KEY_UP]) {
-                intro_text_scroll_enable = 0;
-                if (santaSledge.handbrake == 0)
-                    accelerate_vehicle(&santaSledge, 1.0 / logicFPS);
-            } else {
-                if (santaSledge.speed <= 30)
-                    santaSledge.speed = 0;
-            }
-            if (key[KEY_DOWN]) {
-                brake_vehicle(&santaSledge, 1.0 / logicFPS);
-            }
-
-            if (key[KEY_PAD_PLUS]) {
-            }
-            if (key[KEY_PAD_MINUS]) {
-            }
-            if (mouse_button) {
-                // n_log( LOG_DEBUG , "mouse button: %d" , mouse_button );
-            }
-
-            double x1 = 0, y1 = 0, x2 = 0, y2 = 0;
-            calculate_perpendicular_points(santaSledge.x, santaSledge.y, santaSledge.direction, 20.0, &x1, &y1, &x2, &y2);
-
-            PHYSICS tmp_part;
-            memset(&tmp_part, 0, sizeof(PHYSICS));
-            tmp_part.type = 1;
-            VECTOR3D_SET(tmp_part.speed, 0.0, 0.0, 0.0);
-
-            if (santaSledge.handbrake) {
-                // red
-                VECTOR3D_SET(tmp_part.position, x1 + 2 - rand() % 4, y1 + 2 - rand() % 4, 0.0);
-                add_particle(particle_system, -1, PIXEL_PART, 60000000, 1 + rand() % 3, al_map_rgb(55 + rand() % 200, 0, 0), tmp_part);
-                // green
-                VECTOR3D_SET(tmp_part.position, x1 + 2 - rand() % 4, y1 + 2 - rand() % 4, 0.0);
-                add_particle(particle_system, -1, PIXEL_PART, 60000000, 1 + rand() % 3, al_map_rgb(0, 55 + rand() % 200, 0), tmp_part);
-                // blue
-                VECTOR3D_SET(tmp_part.position, x1 + 2 - rand() % 4, y1 + 2 - rand() % 4, 0.0);
-                add_particle(particle_system, -1, PIXEL_PART, 60000000, 1 + rand() % 3, al_map_rgb(0, 0, 55 + rand() % 200), tmp_part);
-                // red
-                VECTOR3D_SET(tmp_part.position, x2 + 2 - rand() % 4, y2 + 2 - rand() % 4, 0.0);
-                add_particle(particle_system, -1, PIXEL_PART, 60000000, 1 + rand() % 3, al_map_rgb(55 + rand() % 200, 0, 0), tmp_part);
-                // green
-                VECTOR3D_SET(tmp_part.position, x2 + 2 - rand() % 4, y2 + 2 - rand() % 4, 0.0);
-                add_particle(particle_system, -1, PIXEL_PART, 60000000, 1 + rand() % 3, al_map_rgb(0, 55 + rand() % 200, 0), tmp_part);
-                // blue
-                VECTOR3D_SET(tmp_part.position, x2 + 2 - rand() % 4, y2 + 2 - rand() % 4, 0.0);
-                add_particle(particle_system, -1, PIXEL_PART, 60000000, 1 + rand() % 3, al_map_rgb(0, 0, 55 + rand() % 200), tmp_part);
-            } else if (santaSledge.speed > 0) {
-                int grey_value = 50 + rand() % 100;
-                // grey
-                VECTOR3D_SET(tmp_part.position, x1 + 2 - rand() % 4, y1 + 2 - rand() % 4, 0.0);
-                add_particle(particle_system, -1, PIXEL_PART, 60000000, 1 + rand() % 3, al_map_rgb(grey_value, grey_value, grey_value), tmp_part);
-                // grey
-                VECTOR3D_SET(tmp_part.position, x1 + 2 - rand() % 4, y1 + 2 - rand() % 4, 0.0);
-                add_particle(particle_system, -1, PIXEL_PART, 60000000, 1 + rand() % 3, al_map_rgb(grey_value, grey_value, grey_value), tmp_part);
-                // grey
-                VECTOR3D_SET(tmp_part.position, x2 + 2 - rand() % 4, y2 + 2 - rand() % 4, 0.0);
-                add_particle(particle_system, -1, PIXEL_PART, 60000000, 1 + rand() % 3, al_map_rgb(grey_value, grey_value, grey_value), tmp_part);
-                // grey
-                VECTOR3D_SET(tmp_part.position, x2 + 2 - rand() % 4, y2 + 2 - rand() % 4, 0.0);
-                add_particle(particle_system, -1, PIXEL_PART, 60000000, 1 + rand() % 3, al_map_rgb(grey_value, grey_value, grey_value), tmp_part);
-            }
-            // particles on good things
-            // list_foreach(node, good_presents) {
-            //    gift_dash_object* object = node->ptr;
-            //
-
-            // particles on good target
-            if (good_presents->start) {
-                gift_dash_object* object = good_presents->start->ptr;
-                VECTOR3D_SET(tmp_part.position, object->rect.x + object->rect.w / 2, object->rect.y + object->rect.h / 2, 0.0);
-                VECTOR3D_SET(tmp_part.speed, (-5.0 + rand() % 11) / 80.0, (-5.0 + rand() % 11) / 80.0, 0.0);
-                add_particle(particle_system, -1, PIXEL_PART, 900000, 1 + rand() % 7, al_map_rgba(55 + rand() % 200, 0, 0, 50 + rand() % 200), tmp_part);
-                VECTOR3D_SET(tmp_part.speed, (-5.0 + rand() % 11) / 80.0, (-5.0 + rand() % 11) / 80.0, 0.0);
-                add_particle(particle_system, -1, PIXEL_PART, 900000, 1 + rand() % 7, al_map_rgba(0, 55 + rand() % 200, 0, 50 + rand() % 200), tmp_part);
-                VECTOR3D_SET(tmp_part.speed, (-5.0 + rand() % 11) / 80.0, (-5.0 + rand() % 11) / 80.0, 0.0);
-                add_particle(particle_system, -1, PIXEL_PART, 900000, 1 + rand() % 7, al_map_rgba(0, 0, 55 + rand() % 200, 50 + rand() % 200), tmp_part);
-            }
-
-            // particles on bad things
-            list_foreach(node, bad_presents) {
-                gift_dash_object* object = node->ptr;
-                VECTOR3D_SET(tmp_part.position, object->rect.x + object->rect.w / 2, object->rect.y + object->rect.h / 2, 0.0);
-                VECTOR3D_SET(tmp_part.speed, (-5.0 + rand() % 11) / 50.0, (-5.0 + rand() % 11) / 50.0, 0.0);
-                add_particle(particle_system, -1, PIXEL_PART, 600000, 1 + rand() % 7, al_map_rgba(0, 0, 0, 50 + rand() % 200), tmp_part);
-            }
-
-            manage_particle_ex(particle_system, 1000000000 / logicFPS);
-
-            long int previous_x = santaSledge.x;
-            long int previous_y = santaSledge.y;
-            update_vehicle(&santaSledge, 1.0 / logicFPS);
-            // print_vehicle(&santaSledge);
-
-            if (santaSledge.x < -4 * WIDTH)
-                santaSledge.x = 4 * WIDTH;
-            if (santaSledge.x > 4 * WIDTH)
-                santaSledge.x = -4 * WIDTH;
-            if (santaSledge.y < -4 * HEIGHT)
-                santaSledge.y = 4 * HEIGHT;
-            if (santaSledge.y > 4 * HEIGHT)
-                santaSledge.y = -4 * HEIGHT;
-
-            tx = santaSledge.x - WIDTH / 2;
-            ty = santaSledge.y - HEIGHT / 2;
-
-            // Check collision with the target
-            if (good_presents->start) {
-                gift_dash_object* target_item = good_presents->start->ptr;
-                bool collided = check_collision(santaSledgebmp, 0, al_get_bitmap_height(santaSledgebmp) / 2.0, santaSledge.x, santaSledge.y, DEG_TO_RAD(santaSledge.direction), target_item->rect);
-                if (collided) {
-                    target_item = remove_list_node(good_presents, good_presents->start, gift_dash_object);
-                    // add bad particles for collision
-                    VECTOR3D_SET(tmp_part.position, target_item->rect.x + target_item->rect.w / 2, target_item->rect.y + target_item->rect.h / 2, 0.0);
-                    for (int it = 0; it < 200; it++) {
-                        VECTOR3D_SET(tmp_part.speed, (-5.0 + rand() % 11) / 10.0, (-5.0 + rand() % 11) / 10.0, 0.0);
-                        add_particle(particle_system, -1, PIXEL_PART, 700000, 1 + rand() % 7, al_map_rgba(rand() % 255, rand() % 255, rand() % 255, 50 + rand() % 200), tmp_part);
-                    }
-                    free(target_item);
-                    // add more time
-                    max_time += 15000000;
-                }
-            } else  // no start ? all collected, it's a win !
-            {
-                if (!end_text_manager.is_done) {
-                    VECTOR3D_SET(tmp_part.position, (-3 * WIDTH) + rand() % ((6 * WIDTH) - 64), (-3 * HEIGHT) + rand() % ((6 * HEIGHT) - 64), 0.0);
-                    for (int nb_particles = 0; nb_particles < 200; nb_particles++) {
-                        VECTOR3D_SET(tmp_part.speed, (-5.0 + rand() % 11) / 10.0, (-5.0 + rand() % 11) / 10.0, 0.0);
-                        add_particle(particle_system, -1, PIXEL_PART, 500000 + rand() % 500000, 1 + rand() % 3, al_map_rgb(55 + rand() % 200, 55 + rand() % 200, 55 + rand() % 200), tmp_part);
-                    }
-                }
-            }
-
-            // Check collision with the evil items
-            list_foreach(node, bad_presents) {
-                gift_dash_object* item = node->ptr;
-                bool collided = check_collision(santaSledgebmp, 0, al_get_bitmap_height(santaSledgebmp) / 2.0, santaSledge.x, santaSledge.y, DEG_TO_RAD(santaSledge.direction), item->rect);
-                if (collided) {
-                    santaSledge.x = previous_x;
-                    santaSledge.y = previous_y;
-                    santaSledge.speed = -santaSledge.speed / 2;
-                    update_vehicle(&santaSledge, 1.0 / logicFPS);
-                    // add bad particles for collision
-                    VECTOR3D_SET(tmp_part.position, item->rect.x + item->rect.w / 2, item->rect.y + item->rect.h / 2, 0.0);
-                    for (int it = 0; it < 200; it++) {
-                        VECTOR3D_SET(tmp_part.speed, (-5.0 + rand() % 11) / 10.0, (-5.0 + rand() % 11) / 10.0, 0.0);
-                        add_particle(particle_system, -1, PIXEL_PART, 700000, 1 + rand() % 7, al_map_rgba(0, 0, 0, 50 + rand() % 200), tmp_part);
-                    }
-                }
-            }
-
-            // add snow
-            VECTOR3D_SET(tmp_part.position, (-3 * WIDTH) + rand() % ((6 * WIDTH) - 64), (-3 * HEIGHT) + rand() % ((6 * HEIGHT) - 64), 0.0);
-            VECTOR3D_SET(tmp_part.speed, (-2.0 + rand() % 5) / 10.0, (rand() % 11) / 10.0, 0.0);
-            add_particle(particle_system, -1, SINUS_PART, 3000000, 1 + rand() % 3, al_map_rgba(255, 255, 100 + rand() % 50, 50 + rand() % 50), tmp_part);
-            VECTOR3D_SET(tmp_part.speed, (-2.0 + rand() % 5) / 10.0, (rand() % 11) / 10.0, 0.0);
-            add_particle(particle_system, -1, SINUS_PART, 3000000, 1 + rand() % 3, al_map_rgba(255, 255, 100 + rand() % 50, 50 + rand() % 50), tmp_part);
-
-            logic_duration = (logic_duration + get_usec(&logic_chrono)) / 2;
-
-            max_time -= 1000000 / logicFPS;
-            if (max_time <= 0) {
-                max_time = 0;
-                DONE = 1;
-            }
+        __atomic_store_n(&input_mask, keys_to_mask(display_keys), __ATOMIC_RELEASE);
+        N_PROFILE_END(events);
 
-            do_logic = 0;
-        }
+        snapshot = latest_snapshot(&world_snapshots);
         if (do_draw == 1) {
-            start_HiTimer(&drawing_chrono);
+            N_PROFILE_BEGIN(frame);
+
+            // draw between the last two ticks, by the fraction of tick elapsed since the last one was due
+            double alpha = (al_get_time() - snapshot->tick_time) * logicFPS;
+            if (alpha < 0.0)
+                alpha = 0.0;
+            if (alpha > 1.0)
+                alpha = 1.0;
+            VEHICLE* sledge = &snapshot->sledge;
+            double sledge_x = sledge->x, sledge_y = sledge->y, sledge_direction = sledge->direction;
+            // no blending across a world wrap
+            if (fabs(sledge->x - snapshot->previous_x) < WIDTH && fabs(sledge->y - snapshot->previous_y) < HEIGHT) {
+                sledge_x = snapshot->previous_x + (sledge->x - snapshot->previous_x) * alpha;
+                sledge_y = snapshot->previous_y + (sledge->y - snapshot->previous_y) * alpha;
+            }
+            double turn = fmod(sledge->direction - snapshot->previous_direction, 360.0);
+            if (turn > 180.0)
+                turn -= 360.0;
+            if (turn < -180.0)
+                turn += 360.0;
+            sledge_direction = snapshot->previous_direction + turn * alpha;
+
+            // camera centered on the sledge
+            tx = sledge_x - WIDTH / 2;
+            ty = sledge_y - HEIGHT / 2;
+            set_particle_interpolation(snapshot->particles, alpha);
 
             if (backbuffer)
                 scrbuf = al_get_backbuffer(display);
@@ -849,26 +1468,31 @@ int main(int argc, char* argv[]) {
             al_clear_to_color(al_map_rgb(175, 175, 175));
 
             // draw particles
-            draw_particle(particle_system, tx, ty, w, h, 50);
+            N_PROFILE_BEGIN(particle_draw);
+            start_HiTimer(&particle_draw_chrono);
+            draw_particle(snapshot->particles, tx, ty, w, h, 50);
+            __atomic_store_n(&particle_draw_usec, (long int)get_usec(&particle_draw_chrono), __ATOMIC_RELAXED);
+            N_PROFILE_END(particle_draw);
+
+            N_PROFILE_BEGIN(world_draw);
 
             // show car DEBUG
             if (get_log_level() == LOG_DEBUG) {
                 // draw sledge and collision point
-                debug_draw_rotated_bitmap(santaSledgebmp, 0, al_get_bitmap_height(santaSledgebmp) / 2.0, santaSledge.x - tx, santaSledge.y - ty, DEG_TO_RAD(santaSledge.direction));
+                debug_draw_rotated_bitmap(santaSledgebmp, 0, al_get_bitmap_height(santaSledgebmp) / 2.0, sledge_x - tx, sledge_y - ty, DEG_TO_RAD(sledge_direction));
                 // draw mouse
                 al_draw_circle(mx, my, 16, al_map_rgb(255, 0, 0), 2.0);
             } else {
                 // draw santaSledge
-                al_draw_rotated_bitmap(santaSledgebmp, 0, al_get_bitmap_height(santaSledgebmp) / 2.0, WIDTH / 2, HEIGHT / 2, DEG_TO_RAD(santaSledge.direction), 0);
+                al_draw_rotated_bitmap(santaSledgebmp, 0, al_get_bitmap_height(santaSledgebmp) / 2.0, WIDTH / 2, HEIGHT / 2, DEG_TO_RAD(sledge_direction), 0);
             }
 
-            if (good_presents->start) {
-                gift_dash_object* target_item = good_presents->start->ptr;
+            if (snapshot->has_target) {
                 // Computer direction to target
-                double testX = target_item->rect.x + target_item->rect.w / 2;
-                double testY = target_item->rect.y + target_item->rect.h / 2;
-                double dx = testX - santaSledge.x;
-                double dy = testY - santaSledge.y;
+                double testX = snapshot->target.x + snapshot->target.w / 2;
+                double testY = snapshot->target.y + snapshot->target.h / 2;
+                double dx = testX - sledge_x;
+                double dy = testY - sledge_y;
                 double testDist = sqrt(dx * dx + dy * dy);
 
                 // Calculate the arrowhead position
@@ -888,47 +1512,18 @@ int main(int argc, char* argv[]) {
                 al_draw_line(WIDTH / 2, HEIGHT / 2, WIDTH / 2 + (50 * dx) / testDist, HEIGHT / 2 + (50 * dy) / testDist, al_map_rgb(0, 255, 0), 4.0);
             }
 
-            // Draw goods
-            list_foreach(node, good_presents) {
-                gift_dash_object* object = node->ptr;
-                al_draw_bitmap(christmasPresents[object->id], object->rect.x - tx, object->rect.y - ty, 0);
-
-                // Get the dimensions of the bitmap
-                int bitmap_width = al_get_bitmap_width(christmasPresents[object->id]);
-                int bitmap_height = al_get_bitmap_height(christmasPresents[object->id]);
-
-                // Set the rectangle's color to green
-                ALLEGRO_COLOR good_color = al_map_rgba(0, 200, 0, 10);
-
-                // Draw the rectangle around the bitmap
-                al_draw_rectangle(
-                    object->rect.x - tx, object->rect.y - ty,                                 // Top-left corner
-                    object->rect.x - tx + bitmap_width, object->rect.y - ty + bitmap_height,  // Bottom-right corner
-                    good_color,                                                               // Color
-                    3.0                                                                       // Thickness of the rectangle's outline
-                );
-            }
-
-            // draw bad
-            list_foreach(node, bad_presents) {
-                gift_dash_object* object = node->ptr;
-                al_draw_bitmap(bogeymanPresents[object->id], object->rect.x - tx, object->rect.y - ty, 0);
-
-                // Get the dimensions of the bitmap
-                int bitmap_width = al_get_bitmap_width(bogeymanPresents[object->id]);
-                int bitmap_height = al_get_bitmap_height(bogeymanPresents[object->id]);
-
-                // Set the rectangle's color to green
-                ALLEGRO_COLOR bad_color = al_map_rgba(20, 20, 20, 10);
-
-                // Draw the rectangle around the bitmap
-                al_draw_rectangle(
-                    object->rect.x - tx, object->rect.y - ty,                                 // Top-left corner
-                    object->rect.x - tx + bitmap_width, object->rect.y - ty + bitmap_height,  // Bottom-right corner
-                    bad_color,                                                                // Color
-                    3.0                                                                       // Thickness of the rectangle's outline
-                );
+            // draw the presents the logic thread found around the camera
+            visible_objects = snapshot->nb_objects;
+            for (int it = 0; it < snapshot->nb_objects; it++) {
+                SnapshotObject* object = &snapshot->objects[it];
+                if (object->type == good)
+                    draw_present(christmasPresents[object->id], object->rect, al_map_rgba(0, 200, 0, 10));
+                else
+                    draw_present(bogeymanPresents[object->id], object->rect, al_map_rgba(20, 20, 20, 10));
             }
+            // icons by parent texture, then all the outlines
+            flush_sprite_batch(&presents_batch);
+            N_PROFILE_END(world_draw);
 
             if (!backbuffer) {
                 al_unlock_bitmap(scrbuf);
@@ -937,63 +1532,89 @@ int main(int argc, char* argv[]) {
                                h / 2 - al_get_bitmap_height(scrbuf) / 2, 0);
             }
 
-            if (intro_text_scroll_enable && !start_text_manager.is_done) {
-                update_text_manager(&start_text_manager, 1.0 / 60.0);
+            N_PROFILE_BEGIN(hud);
+            if (snapshot->intro_scrolling && !start_text_manager.is_done) {
+                update_text_manager(&start_text_manager, 1.0 / drawFPS);
                 render_text_manager(&start_text_manager, WIDTH, HEIGHT);
             }
 
-            if (!good_presents->start) {
+            if (!snapshot->has_target) {
                 // we won !!
                 if (!end_text_manager.is_done) {
-                    update_text_manager(&end_text_manager, 1.0 / 60.0);
+                    update_text_manager(&end_text_manager, 1.0 / drawFPS);
                     render_text_manager(&end_text_manager, WIDTH, HEIGHT);
-                } else {
-                    static bool remove_bad_items = 0;
-                    if (!remove_bad_items) {
-                        remove_bad_items = 1;
-                        list_empty(bad_presents);
-                    }
                 }
             }
 
             // print  speed
-            nstrprintf(textout, "Speed: %d", (int)santaSledge.speed);
-            al_draw_text(little_font, al_map_rgb(0, 0, 255), WIDTH, 10, ALLEGRO_ALIGN_RIGHT, _nstr(textout));
+            draw_hud_field(&speed_hud, (int)sledge->speed);
             // print goodies to collect
-            if (good_presents->nb_items > 0) {
-                nstrprintf(textout, "Goodies to collect: %d", good_presents->nb_items);
-                al_draw_text(little_font, al_map_rgb(0, 0, 255), 10, 10, ALLEGRO_ALIGN_LEFT, _nstr(textout));
+            if (snapshot->nb_good_presents > 0) {
+                draw_hud_field(&goodies_hud, snapshot->nb_good_presents);
             }
 
-            if (good_presents->start) {
-                nstrprintf(textout, "Time left: %d s", (int)(max_time / 1000000));
-                al_draw_text(little_font, al_map_rgb(0, 0, 255), 10, 30, ALLEGRO_ALIGN_LEFT, _nstr(textout));
+            if (snapshot->has_target) {
+                draw_hud_field(&time_hud, (int)(snapshot->max_time / 1000000));
             }
-            drawing_duration = (drawing_duration + get_usec(&drawing_chrono)) / 2;
+            if (show_stats) {
+                // profiled zones, bottom up
+                int line_y = HEIGHT - 30;
+                nstrprintf(textout, "Visible objects: %d/%d", visible_objects, snapshot->nb_good_presents + snapshot->nb_bad_presents);
+                al_draw_text(little_font, al_map_rgb(0, 0, 255), 10, line_y, ALLEGRO_ALIGN_LEFT, _nstr(textout));
+                for (int zone = n_profile_nb_zones() - 1; zone >= 0; zone--) {
+                    N_PROFILE_STATS stats;
+                    if (!n_profile_get_stats(zone, &stats))
+                        continue;
+                    line_y -= 26;
+                    nstrprintf(textout, "%s: p50 %.1f p95 %.1f p99 %.1f max %.1f us", stats.name, stats.p50 / 1000.0, stats.p95 / 1000.0, stats.p99 / 1000.0, stats.max / 1000.0);
+                    al_draw_text(little_font, al_map_rgb(0, 0, 255), 10, line_y, ALLEGRO_ALIGN_LEFT, _nstr(textout));
+                }
+            }
+            N_PROFILE_END(hud);
+            N_PROFILE_END(frame);
 
+            N_PROFILE_BEGIN(flip);
             al_flip_display();
+            N_PROFILE_END(flip);
             do_draw = 0;
         }
 
-    } while (!key[KEY_ESC] && !DONE);
+    } while (!display_keys[KEY_ESC] && !snapshot->done);
+
+    __atomic_store_n(&stop_logic, 1, __ATOMIC_RELEASE);
+    pthread_join(logic_thread_id, NULL);
+    free_snapshot_buffer(&world_snapshots);
+    if (trace_file)
+        n_profile_dump_trace(trace_file);
+    n_profile_free();
 
-    if (DONE && good_presents->start) {
+    if (DONE && good_presents->start && !journal_replay_ended) {
         al_clear_to_color(al_map_rgb(0, 0, 0));
         nstrprintf(textout, "YOU LOOSE, TIME'S UP !!");
         al_draw_text(big_font, al_map_rgb(255, 0, 0), WIDTH / 2, HEIGHT / 2, ALLEGRO_ALIGN_CENTER, _nstr(textout));
         nstrprintf(textout, "[PRESS ESC TO EXIT]");
         al_draw_text(big_font, al_map_rgb(255, 0, 0), WIDTH / 2, (HEIGHT / 2) + 50, ALLEGRO_ALIGN_CENTER, _nstr(textout));
         al_flip_display();
-        key[KEY_ESC] = 0;
+        display_keys[KEY_ESC] = 0;
         do {
             ALLEGRO_EVENT ev;
             al_wait_for_event(event_queue, &ev);
             if (ev.type == ALLEGRO_EVENT_KEY_DOWN && ev.keyboard.keycode == ALLEGRO_KEY_ESCAPE) {
-                key[KEY_ESC] = 1;
+                display_keys[KEY_ESC] = 1;
             }
-        } while (!key[KEY_ESC]);
+        } while (!display_keys[KEY_ESC]);
     }
 
+    close_input_journal(&input_journal);
+    free_text_manager(&start_text_manager);
+    free_text_manager(&end_text_manager);
+    free_hud_field(&speed_hud);
+    free_hud_field(&goodies_hud);
+    free_hud_field(&time_hud);
+    free_music_player(&music_player);
+    free_world_masks();
+    if (playlist)
+        free_split_result(&playlist);
     al_uninstall_system();
 
     return 0;
@@ -0,0 +1,174 @@
+#include "asset_manager.h"
+#include <string.h>
+#include "nilorea/n_common.h"
+#include "nilorea/n_log.h"
+
+// Set up a manager for up to max_assets files
+bool init_asset_manager(AssetManager* manager, THREAD_POOL* thread_pool, int max_assets, AssetProgressCallback progress, void* user_data) {
+    __n_assert(manager, return false);
+    __n_assert(thread_pool, return false);
+
+    memset(manager, 0, sizeof(AssetManager));
+    Malloc(manager->assets, Asset, max_assets);
+    __n_assert(manager->assets, return false);
+    manager->max_assets = max_assets;
+    manager->thread_pool = thread_pool;
+    manager->progress = progress;
+    manager->user_data = user_data;
+    return true;
+}
+
+// Queue a file of any kind
+static int add_asset(AssetManager* manager, int type, const char* filename, int size) {
+    __n_assert(manager, return -1);
+    __n_assert(filename, return -1);
+    if (manager->started) {
+        n_log(LOG_ERR, "cannot add %s, the loading already started", filename);
+        return -1;
+    }
+    if (manager->nb_assets >= manager->max_assets) {
+        n_log(LOG_ERR, "cannot add %s, %d assets max", filename, manager->max_assets);
+        return -1;
+    }
+    Asset* asset = &manager->assets[manager->nb_assets];
+    asset->type = type;
+    asset->filename = strdup(filename);
+    asset->size = size;
+    asset->data = NULL;
+    asset->state = ASSET_QUEUED;
+    asset->reported = false;
+    return manager->nb_assets++;
+}
+
+// Queue an image
+int add_bitmap_asset(AssetManager* manager, const char* filename) {
+    return add_asset(manager, ASSET_BITMAP, filename, 0);
+}
+
+// Queue a font of the given size
+int add_font_asset(AssetManager* manager, const char* filename, int size) {
+    return add_asset(manager, ASSET_FONT, filename, size);
+}
+
+// Queue a sound
+int add_sample_asset(AssetManager* manager, const char* filename) {
+    return add_asset(manager, ASSET_SAMPLE, filename, 0);
+}
+
+// Load one file, on a worker for images and sounds. Images go in memory bitmaps since a worker has no display to create
+// textures on. Fonts are loaded by the calling thread: they only open the file here, their glyph pages are created by
+// the thread that draws
+static void* decode_asset(void* param) {
+    Asset* asset = (Asset*)param;
+    ALLEGRO_STATE state;
+
+    switch (asset->type) {
+        case ASSET_BITMAP:
+            al_store_state(&state, ALLEGRO_STATE_NEW_BITMAP_PARAMETERS);
+            al_set_new_bitmap_flags(ALLEGRO_MEMORY_BITMAP);
+            asset->data = al_load_bitmap(asset->filename);
+            al_restore_state(&state);
+            break;
+        case ASSET_FONT:
+            asset->data = al_load_font(asset->filename, asset->size, 0);
+            break;
+        case ASSET_SAMPLE:
+            asset->data = al_load_sample(asset->filename);
+            break;
+        default:
+            break;
+    }
+    // release: data is visible to the display thread before the new state
+    __atomic_store_n(&asset->state, asset->data ? ASSET_DECODED : ASSET_FAILED, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+// Hand the queued images and sounds to the workers, and load the fonts. The TTF addon opens every face on one
+// FreeType library without a lock, so fonts can not be opened by several workers at once. Files beyond the number of
+// workers wait in the pool waiting list
+bool start_asset_loading(AssetManager* manager) {
+    __n_assert(manager, return false);
+
+    manager->started = true;
+    for (int it = 0; it < manager->nb_assets; it++) {
+        if (manager->assets[it].type == ASSET_FONT) {
+            decode_asset(&manager->assets[it]);
+            continue;
+        }
+        if (add_threaded_process(manager->thread_pool, &decode_asset, &manager->assets[it], DIRECT_PROC) == FALSE) {
+            n_log(LOG_ERR, "could not queue the loading of %s", manager->assets[it].filename);
+            manager->assets[it].state = ASSET_FAILED;
+        }
+    }
+    return true;
+}
+
+// Upload the decoded assets and report the progress
+bool update_asset_loading(AssetManager* manager) {
+    __n_assert(manager, return true);
+
+    for (int it = 0; it < manager->nb_assets; it++) {
+        Asset* asset = &manager->assets[it];
+        int state = __atomic_load_n(&asset->state, __ATOMIC_ACQUIRE);
+        if (state == ASSET_QUEUED || asset->reported)
+            continue;
+
+        if (state == ASSET_DECODED) {
+            // on the display thread the default bitmap flags give a video bitmap
+            if (asset->type == ASSET_BITMAP && al_get_current_display())
+                al_convert_bitmap((ALLEGRO_BITMAP*)asset->data);
+            asset->state = ASSET_READY;
+        } else {
+            n_log(LOG_ERR, "could not load %s", asset->filename);
+            manager->nb_failed++;
+        }
+        asset->reported = true;
+        manager->nb_done++;
+        if (manager->progress)
+            manager->progress(manager->nb_done, manager->nb_assets, asset, manager->user_data);
+    }
+    return manager->nb_done >= manager->nb_assets;
+}
+
+// Update the loading until it is over
+bool wait_for_assets(AssetManager* manager) {
+    __n_assert(manager, return false);
+
+    while (!update_asset_loading(manager))
+        al_rest(0.001);
+    return manager->nb_failed == 0;
+}
+
+// Get a ready asset of the given kind
+static void* asset_data(AssetManager* manager, int id, int type) {
+    __n_assert(manager, return NULL);
+    if (id < 0 || id >= manager->nb_assets)
+        return NULL;
+    Asset* asset = &manager->assets[id];
+    if (asset->type != type || asset->state != ASSET_READY)
+        return NULL;
+    return asset->data;
+}
+
+ALLEGRO_BITMAP* asset_bitmap(AssetManager* manager, int id) {
+    return (ALLEGRO_BITMAP*)asset_data(manager, id, ASSET_BITMAP);
+}
+
+ALLEGRO_FONT* asset_font(AssetManager* manager, int id) {
+    return (ALLEGRO_FONT*)asset_data(manager, id, ASSET_FONT);
+}
+
+ALLEGRO_SAMPLE* asset_sample(AssetManager* manager, int id) {
+    return (ALLEGRO_SAMPLE*)asset_data(manager, id, ASSET_SAMPLE);
+}
+
+// Free the manager. The loaded assets are left to the caller
+void free_asset_manager(AssetManager* manager) {
+    if (!manager || !manager->assets)
+        return;
+    for (int it = 0; it < manager->nb_assets; it++)
+        FreeNoLog(manager->assets[it].filename);
+    FreeNoLog(manager->assets);
+    manager->nb_assets = 0;
+    manager->max_assets = 0;
+}
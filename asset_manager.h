@@ -0,0 +1,85 @@
+/**\file asset_manager.h
+ *  assets decoded on the thread pool and uploaded on the display thread for hacks
+ *\author Castagnier Mickaël aka Gull Ra Driel
+ *\version 1.0
+ *\date 16/10/2026
+ */
+
+#ifndef ASSET_MANAGER_HEADER_FOR_HACKS
+#define ASSET_MANAGER_HEADER_FOR_HACKS
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_font.h>
+#include "allegro5/allegro_audio.h"
+#include "nilorea/n_thread_pool.h"
+
+// Kinds of assets
+#define ASSET_BITMAP 0  // Image, decoded in a memory bitmap then converted to a video bitmap
+#define ASSET_FONT 1    // Font file, its glyph pages are created on first draw
+#define ASSET_SAMPLE 2  // Sound fully decoded in memory
+
+// Loading states, written by the worker then by the display thread
+#define ASSET_QUEUED 0   // Waiting for a worker
+#define ASSET_DECODED 1  // Decoded by a worker, not uploaded yet
+#define ASSET_READY 2    // Usable
+#define ASSET_FAILED 3   // Could not be loaded
+
+// One file to load
+typedef struct {
+    int type;        // ASSET_BITMAP, ASSET_FONT or ASSET_SAMPLE
+    char* filename;  // File to load
+    int size;        // Font size, unused by the other kinds
+    void* data;      // ALLEGRO_BITMAP*, ALLEGRO_FONT* or ALLEGRO_SAMPLE* once loaded
+    int state;       // ASSET_QUEUED, ASSET_DECODED, ASSET_READY or ASSET_FAILED
+    bool reported;   // Counted in the progress, set by the display thread
+} Asset;
+
+// Called on the display thread each time an asset is ready or failed
+typedef void (*AssetProgressCallback)(int nb_done, int nb_assets, const Asset* asset, void* user_data);
+
+// Assets loaded all at once: every image and sound is decoded on its own worker, so loading takes as long as the slowest one.
+// Fonts are opened by the thread starting the loading
+typedef struct {
+    Asset* assets;                    // Assets to load
+    int nb_assets;                    // Number of assets
+    int max_assets;                   // Size of assets
+    int nb_done;                      // Assets ready or failed
+    int nb_failed;                    // Assets that failed
+    bool started;                     // No asset can be added once the loading started
+    THREAD_POOL* thread_pool;         // Workers decoding the files
+    AssetProgressCallback progress;   // Progress callback, may be NULL
+    void* user_data;                  // Passed to progress
+} AssetManager;
+
+// Set up a manager for up to max_assets files, decoded on thread_pool
+bool init_asset_manager(AssetManager* manager, THREAD_POOL* thread_pool, int max_assets, AssetProgressCallback progress, void* user_data);
+// Queue an image, returning its id or -1
+int add_bitmap_asset(AssetManager* manager, const char* filename);
+// Queue a font of the given size, returning its id or -1
+int add_font_asset(AssetManager* manager, const char* filename, int size);
+// Queue a sound, returning its id or -1
+int add_sample_asset(AssetManager* manager, const char* filename);
+// Hand the queued images and sounds to the workers and open the fonts
+bool start_asset_loading(AssetManager* manager);
+// Display thread: upload the decoded assets and report the progress. Returns true once every asset is ready or failed
+bool update_asset_loading(AssetManager* manager);
+// Display thread: update the loading until it is over. Returns true if no asset failed
+bool wait_for_assets(AssetManager* manager);
+// Get a loaded asset, NULL if it is not ready
+ALLEGRO_BITMAP* asset_bitmap(AssetManager* manager, int id);
+ALLEGRO_FONT* asset_font(AssetManager* manager, int id);
+ALLEGRO_SAMPLE* asset_sample(AssetManager* manager, int id);
+// Free the manager. The loaded assets are left to the caller
+void free_asset_manager(AssetManager* manager);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,160 @@
+#include "collision_grid.h"
+#include <math.h>
+#include "nilorea/n_common.h"
+#include "nilorea/n_log.h"
+
+// Maximum number of cells, the cell size is raised to stay under it
+#define COLLISION_GRID_MAX_CELLS (1 << 22)
+
+// Get the range of cells overlapped by a rectangle, clamped to the grid
+static void collision_grid_cell_range(const CollisionGrid* grid, CollisionRectangle rect, int* x1, int* y1, int* x2, int* y2) {
+    *x1 = (int)floor((rect.x - grid->origin_x) / grid->cell_size);
+    *y1 = (int)floor((rect.y - grid->origin_y) / grid->cell_size);
+    *x2 = (int)floor((rect.x + rect.w - grid->origin_x) / grid->cell_size);
+    *y2 = (int)floor((rect.y + rect.h - grid->origin_y) / grid->cell_size);
+    if (*x1 < 0) *x1 = 0;
+    if (*y1 < 0) *y1 = 0;
+    if (*x2 >= grid->cols) *x2 = grid->cols - 1;
+    if (*y2 >= grid->rows) *y2 = grid->rows - 1;
+}
+
+// Build the grid: count the objects of each cell, then pack their indices
+bool init_collision_grid(CollisionGrid* grid, const CollisionRectangle* rects, void** objects, int nb_objects, double cell_size) {
+    __n_assert(grid, return false);
+    memset(grid, 0, sizeof(CollisionGrid));
+    if (nb_objects <= 0)
+        return true;
+    __n_assert(rects, return false);
+    __n_assert(objects, return false);
+
+    // world bounds of the objects
+    double min_x = rects[0].x, min_y = rects[0].y;
+    double max_x = rects[0].x + rects[0].w, max_y = rects[0].y + rects[0].h;
+    for (int i = 1; i < nb_objects; i++) {
+        if (rects[i].x < min_x) min_x = rects[i].x;
+        if (rects[i].y < min_y) min_y = rects[i].y;
+        if (rects[i].x + rects[i].w > max_x) max_x = rects[i].x + rects[i].w;
+        if (rects[i].y + rects[i].h > max_y) max_y = rects[i].y + rects[i].h;
+    }
+
+    if (cell_size <= 0.0)
+        cell_size = 1.0;
+    while (((max_x - min_x) / cell_size + 1.0) * ((max_y - min_y) / cell_size + 1.0) > COLLISION_GRID_MAX_CELLS)
+        cell_size *= 2.0;
+
+    grid->origin_x = min_x;
+    grid->origin_y = min_y;
+    grid->cell_size = cell_size;
+    grid->cols = (int)floor((max_x - min_x) / cell_size) + 1;
+    grid->rows = (int)floor((max_y - min_y) / cell_size) + 1;
+    grid->nb_objects = nb_objects;
+
+    int nb_cells = grid->cols * grid->rows;
+    Malloc(grid->cell_start, int, nb_cells + 1);
+    Malloc(grid->rects, CollisionRectangle, nb_objects);
+    Malloc(grid->objects, void*, nb_objects);
+    Malloc(grid->stamps, unsigned int, nb_objects);
+    if (!grid->cell_start || !grid->rects || !grid->objects || !grid->stamps) {
+        clear_collision_grid(grid);
+        return false;
+    }
+    memcpy(grid->rects, rects, nb_objects * sizeof(CollisionRectangle));
+    memcpy(grid->objects, objects, nb_objects * sizeof(void*));
+
+    // count pass: cell_start[c + 1] holds the number of objects of cell c
+    int x1, y1, x2, y2;
+    for (int i = 0; i < nb_objects; i++) {
+        collision_grid_cell_range(grid, rects[i], &x1, &y1, &x2, &y2);
+        for (int y = y1; y <= y2; y++)
+            for (int x = x1; x <= x2; x++)
+                grid->cell_start[y * grid->cols + x + 1]++;
+    }
+    for (int c = 0; c < nb_cells; c++)
+        grid->cell_start[c + 1] += grid->cell_start[c];
+
+    // fill pass, using a moving cursor per cell
+    int* cursor = NULL;
+    Malloc(grid->entries, int, grid->cell_start[nb_cells]);
+    Malloc(cursor, int, nb_cells);
+    if (!grid->entries || !cursor) {
+        FreeNoLog(cursor);
+        clear_collision_grid(grid);
+        return false;
+    }
+    memcpy(cursor, grid->cell_start, nb_cells * sizeof(int));
+    for (int i = 0; i < nb_objects; i++) {
+        collision_grid_cell_range(grid, rects[i], &x1, &y1, &x2, &y2);
+        for (int y = y1; y <= y2; y++)
+            for (int x = x1; x <= x2; x++)
+                grid->entries[cursor[y * grid->cols + x]++] = i;
+    }
+    FreeNoLog(cursor);
+
+    n_log(LOG_DEBUG, "collision grid: %d objects in %dx%d cells of %g", nb_objects, grid->cols, grid->rows, cell_size);
+    return true;
+}
+
+// Collect the objects of the cells overlapped by area, keeping those whose rectangle really overlaps it.
+// Once results is full the objects are still counted, so the caller knows it missed some
+int query_collision_grid(CollisionGrid* grid, CollisionRectangle area, void** results, int max_results) {
+    __n_assert(grid, return 0);
+    if (grid->nb_objects <= 0 || max_results <= 0)
+        return 0;
+
+    // outside the grid
+    if (area.x > grid->origin_x + grid->cols * grid->cell_size || area.x + area.w < grid->origin_x ||
+        area.y > grid->origin_y + grid->rows * grid->cell_size || area.y + area.h < grid->origin_y)
+        return 0;
+
+    // new query id, so objects spanning several cells are returned once
+    grid->stamp++;
+    if (grid->stamp == 0) {
+        memset(grid->stamps, 0, grid->nb_objects * sizeof(unsigned int));
+        grid->stamp = 1;
+    }
+
+    int nb_results = 0;
+    int x1, y1, x2, y2;
+    collision_grid_cell_range(grid, area, &x1, &y1, &x2, &y2);
+    for (int y = y1; y <= y2; y++) {
+        for (int x = x1; x <= x2; x++) {
+            int c = y * grid->cols + x;
+            for (int e = grid->cell_start[c]; e < grid->cell_start[c + 1]; e++) {
+                int i = grid->entries[e];
+                if (grid->stamps[i] == grid->stamp)
+                    continue;
+                grid->stamps[i] = grid->stamp;
+                if (!grid->objects[i])
+                    continue;
+                CollisionRectangle* r = &grid->rects[i];
+                if (r->x > area.x + area.w || r->x + r->w < area.x || r->y > area.y + area.h || r->y + r->h < area.y)
+                    continue;
+                if (nb_results < max_results)
+                    results[nb_results] = grid->objects[i];
+                nb_results++;
+            }
+        }
+    }
+    return nb_results;
+}
+
+// Removed objects stay in their cells and are skipped by queries
+void remove_from_collision_grid(CollisionGrid* grid, int index) {
+    __n_assert(grid, return);
+    if (index < 0 || index >= grid->nb_objects)
+        return;
+    grid->objects[index] = NULL;
+}
+
+// Free the grid storage
+void clear_collision_grid(CollisionGrid* grid) {
+    if (!grid)
+        return;
+    FreeNoLog(grid->cell_start);
+    FreeNoLog(grid->entries);
+    FreeNoLog(grid->rects);
+    FreeNoLog(grid->objects);
+    FreeNoLog(grid->stamps);
+    grid->nb_objects = 0;
+    grid->cols = grid->rows = 0;
+}
@@ -0,0 +1,49 @@
+/**\file collision_grid.h
+ *  static uniform grid broad-phase for sledge vs objects collisions
+ *\author Castagnier Mickaël aka Gull Ra Driel
+ *\version 1.0
+ *\date 16/10/2026
+ */
+
+#ifndef COLLISION_GRID_HEADER_FOR_HACKS
+#define COLLISION_GRID_HEADER_FOR_HACKS
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+
+#include "sledge_physics.h"
+
+// Uniform grid built once over a static set of rectangles.
+// Cells store object indices in a packed array: the objects of cell c are
+// entries[cell_start[c]] to entries[cell_start[c + 1] - 1]
+typedef struct {
+    double origin_x, origin_y;  // Top-left corner of the grid
+    double cell_size;           // Width and height of a cell
+    int cols, rows;             // Grid dimensions in cells
+    int* cell_start;            // Offset of each cell in entries, cols * rows + 1 values
+    int* entries;               // Object indices, grouped by cell
+    CollisionRectangle* rects;  // Copy of the object rectangles
+    void** objects;             // User pointer of each object, NULL once removed
+    int nb_objects;             // Number of objects in the grid
+    unsigned int* stamps;       // Last query that returned each object
+    unsigned int stamp;         // Current query id, wraps around to 1
+} CollisionGrid;
+
+// Build a grid over nb_objects rectangles, objects[i] being returned by queries for rects[i]
+bool init_collision_grid(CollisionGrid* grid, const CollisionRectangle* rects, void** objects, int nb_objects, double cell_size);
+// Fill results with up to max_results objects whose rectangle overlaps area, each one once. Returns the number of objects found,
+// which is larger than max_results if some of them did not fit in results
+int query_collision_grid(CollisionGrid* grid, CollisionRectangle area, void** results, int max_results);
+// Stop returning the object built from rects[index]
+void remove_from_collision_grid(CollisionGrid* grid, int index);
+// Free the grid storage and leave it empty
+void clear_collision_grid(CollisionGrid* grid);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,219 @@
+#include "collision_mask.h"
+#include <math.h>
+#include <string.h>
+#include "nilorea/n_common.h"
+#include "nilorea/n_log.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Make room for a width x height mask, keeping the allocation if it is large enough
+static bool resize_collision_mask(CollisionMask* mask, int width, int height) {
+    int words = (width + 63) / 64;
+    if (words * height > mask->capacity) {
+        FreeNoLog(mask->bits);
+        mask->capacity = 0;
+        Malloc(mask->bits, uint64_t, words * height);
+        __n_assert(mask->bits, return false);
+        mask->capacity = words * height;
+    }
+    mask->width = width;
+    mask->height = height;
+    mask->words = words;
+    memset(mask->bits, 0, words * height * sizeof(uint64_t));
+    return true;
+}
+
+// Build the mask of a bitmap
+bool build_collision_mask(CollisionMask* mask, ALLEGRO_BITMAP* bitmap, int alpha_threshold) {
+    __n_assert(mask, return false);
+    __n_assert(bitmap, return false);
+
+    memset(mask, 0, sizeof(CollisionMask));
+    int width = al_get_bitmap_width(bitmap);
+    int height = al_get_bitmap_height(bitmap);
+    if (!resize_collision_mask(mask, width, height))
+        return false;
+
+    al_lock_bitmap(bitmap, al_get_bitmap_format(bitmap), ALLEGRO_LOCK_READONLY);
+    for (int y = 0; y < height; y++) {
+        uint64_t* row = &mask->bits[y * mask->words];
+        for (int x = 0; x < width; x++) {
+            unsigned char r, g, b, a;
+            al_unmap_rgba(al_get_pixel(bitmap, x, y), &r, &g, &b, &a);
+            if (a >= alpha_threshold)
+                row[x / 64] |= (uint64_t)1 << (x % 64);
+        }
+    }
+    al_unlock_bitmap(bitmap);
+    return true;
+}
+
+// Fill placed with the clipped rotated src. A placed pixel is solid if the src pixel under its center is
+bool place_collision_mask(CollisionMask* placed, const CollisionMask* src, double cx, double cy, double dx, double dy, double angle, int clip_x, int clip_y, int clip_w, int clip_h) {
+    double cosA = cos(angle);
+    double sinA = sin(angle);
+
+    // world bounds of the rotated mask
+    double min_x = dx, max_x = dx, min_y = dy, max_y = dy;
+    double corners[4][2] = {{-cx, -cy}, {src->width - cx, -cy}, {src->width - cx, src->height - cy}, {-cx, src->height - cy}};
+    for (int i = 0; i < 4; i++) {
+        double x = dx + corners[i][0] * cosA - corners[i][1] * sinA;
+        double y = dy + corners[i][0] * sinA + corners[i][1] * cosA;
+        if (i == 0 || x < min_x) min_x = x;
+        if (i == 0 || x > max_x) max_x = x;
+        if (i == 0 || y < min_y) min_y = y;
+        if (i == 0 || y > max_y) max_y = y;
+    }
+    int x1 = (int)floor(min_x), y1 = (int)floor(min_y);
+    int x2 = (int)ceil(max_x), y2 = (int)ceil(max_y);
+    if (x1 < clip_x) x1 = clip_x;
+    if (y1 < clip_y) y1 = clip_y;
+    if (x2 > clip_x + clip_w) x2 = clip_x + clip_w;
+    if (y2 > clip_y + clip_h) y2 = clip_y + clip_h;
+    if (x1 >= x2 || y1 >= y2)
+        return false;
+
+    if (!resize_collision_mask(placed, x2 - x1, y2 - y1))
+        return false;
+    placed->x = x1;
+    placed->y = y1;
+
+    int64_t step_u = llround(cosA * 65536.0);
+    int64_t step_v = llround(-sinA * 65536.0);
+    for (int y = 0; y < placed->height; y++) {
+        uint64_t* row = &placed->bits[y * placed->words];
+        // src position of the row first pixel center, the next ones are one rotated step apart
+        double wx = x1 + 0.5 - dx;
+        double wy = y1 + y + 0.5 - dy;
+        // in 16.16 fixed point: a negative position becomes a huge unsigned one, so a single compare clips each axis
+        int64_t u = llround((cx + wx * cosA + wy * sinA) * 65536.0);
+        int64_t v = llround((cy - wx * sinA + wy * cosA) * 65536.0);
+        for (int x = 0; x < placed->width; x++, u += step_u, v += step_v) {
+            uint64_t sx = (uint64_t)(u >> 16), sy = (uint64_t)(v >> 16);
+            if (sx >= (uint64_t)src->width || sy >= (uint64_t)src->height)
+                continue;
+            if (src->bits[sy * src->words + sx / 64] & ((uint64_t)1 << (sx % 64)))
+                row[x / 64] |= (uint64_t)1 << (x % 64);
+        }
+    }
+    return true;
+}
+
+// 64 bits of a row starting at pixel start, which may be outside the row. Pixels outside are clear
+static inline uint64_t mask_row_bits(const uint64_t* row, int words, int start) {
+    int word = start >= 0 ? start / 64 : -((63 - start) / 64);
+    int shift = start - word * 64;
+    uint64_t low = (word >= 0 && word < words) ? row[word] : 0;
+    if (!shift)
+        return low;
+    uint64_t high = (word + 1 >= 0 && word + 1 < words) ? row[word + 1] : 0;
+    return (low >> shift) | (high << (64 - shift));
+}
+
+// AND the rows of a with the rows of b shifted to a pixels. The words of a row are ORed together and tested once per row.
+// With SSE2 the words of a whose b neighbours are both inside the row are ANDed two at a time: word w of a meets b
+// words w + delta and w + delta + 1 shifted right by shift, the same for every row. The other words use mask_row_bits
+bool collision_masks_overlap(const CollisionMask* a, int ax, int ay, const CollisionMask* b, int bx, int by) {
+    int y1 = ay > by ? ay : by;
+    int y2 = (ay + a->height < by + b->height) ? ay + a->height : by + b->height;
+    int x1 = ax > bx ? ax : bx;
+    int x2 = (ax + a->width < bx + b->width) ? ax + a->width : bx + b->width;
+    if (x1 >= x2 || y1 >= y2)
+        return false;
+
+    // words of a covering the overlap, and where b starts in a pixels
+    int first_word = (x1 - ax) / 64;
+    int last_word = (x2 - 1 - ax) / 64;
+    int offset = bx - ax;
+#ifdef __SSE2__
+    int delta = (offset <= 0) ? -offset / 64 : -((offset + 63) / 64);
+    int shift = -offset - delta * 64;
+    // a shift count of 64 clears the lanes, so shift 0 needs no special case
+    __m128i right = _mm_cvtsi32_si128(shift);
+    __m128i left = _mm_cvtsi32_si128(64 - shift);
+    // pairs of words from simd_start, while both lanes b neighbours are inside the row
+    int simd_start = (first_word + delta < 0) ? -delta : first_word;
+    int simd_pairs = 0;
+    while (simd_start + 2 * simd_pairs + 1 <= last_word && simd_start + 2 * simd_pairs + delta + 2 < b->words)
+        simd_pairs++;
+    if (!simd_pairs)
+        simd_start = last_word + 1;
+    int simd_end = simd_start + 2 * simd_pairs;
+#endif
+    for (int y = y1; y < y2; y++) {
+        const uint64_t* row_a = &a->bits[(y - ay) * a->words];
+        const uint64_t* row_b = &b->bits[(y - by) * b->words];
+        uint64_t hit = 0;
+#ifdef __SSE2__
+        for (int w = first_word; w < simd_start; w++)
+            hit |= row_a[w] & mask_row_bits(row_b, b->words, w * 64 - offset);
+        __m128i hits = _mm_setzero_si128();
+        for (int w = simd_start; w < simd_end; w += 2) {
+            __m128i low = _mm_loadu_si128((const __m128i*)&row_b[w + delta]);
+            __m128i high = _mm_loadu_si128((const __m128i*)&row_b[w + delta + 1]);
+            __m128i shifted = _mm_or_si128(_mm_srl_epi64(low, right), _mm_sll_epi64(high, left));
+            hits = _mm_or_si128(hits, _mm_and_si128(_mm_loadu_si128((const __m128i*)&row_a[w]), shifted));
+        }
+        uint64_t lanes[2];
+        _mm_storeu_si128((__m128i*)lanes, hits);
+        hit |= lanes[0] | lanes[1];
+        for (int w = simd_end > first_word ? simd_end : first_word; w <= last_word; w++)
+            hit |= row_a[w] & mask_row_bits(row_b, b->words, w * 64 - offset);
+#else
+        for (int w = first_word; w <= last_word; w++)
+            hit |= row_a[w] & mask_row_bits(row_b, b->words, w * 64 - offset);
+#endif
+        if (hit)
+            return true;
+    }
+    return false;
+}
+
+// Test poses of the move from time from to 1, close enough for the mask corners to move by at most MASK_SWEEP_STEP
+// pixels between two of them: the number of poses grows with the move and the turn, with no cap, so thin solid parts
+// can not be stepped over. The mask is only placed again when it turned by that much since its last placement,
+// the poses in between are tested by shifting it to the nearest pixel, so most of them only cost the rows ANDs.
+// A placement covers the target rectangle grown by the rest of the move
+double swept_mask_collision(CollisionMask* placed, const CollisionMask* mover, double cx, double cy, double x0, double y0, double angle0, double x1, double y1, double angle1, double from, const CollisionMask* target, int target_x, int target_y) {
+    // shortest turn, angles may have wrapped around
+    double turn = remainder(angle1 - angle0, 2.0 * M_PI);
+    double radius = hypot(fmax(cx, mover->width - cx), fmax(cy, mover->height - cy));
+    double move = hypot(x1 - x0, y1 - y0) * (1.0 - from);
+    double poses = ceil((move + radius * fabs(turn) * (1.0 - from)) / MASK_SWEEP_STEP);
+    int steps = (poses >= 1.0) ? (int)poses : 1;
+    int margin = (int)ceil(move) + 1;
+
+    bool is_placed = false, is_empty = true;
+    double placed_x = 0.0, placed_y = 0.0, placed_angle = 0.0;
+    for (int step = 0; step <= steps; step++) {
+        double t = from + (1.0 - from) * step / steps;
+        double x = x0 + (x1 - x0) * t;
+        double y = y0 + (y1 - y0) * t;
+        double angle = angle0 + turn * t;
+        if (!is_placed || radius * fabs(angle - placed_angle) > MASK_SWEEP_STEP) {
+            is_empty = !place_collision_mask(placed, mover, cx, cy, x, y, angle, target_x - margin, target_y - margin, target->width + 2 * margin, target->height + 2 * margin);
+            is_placed = true;
+            placed_x = x;
+            placed_y = y;
+            placed_angle = angle;
+        }
+        if (is_empty)
+            continue;
+        int shift_x = (int)lround(x - placed_x);
+        int shift_y = (int)lround(y - placed_y);
+        if (collision_masks_overlap(placed, placed->x + shift_x, placed->y + shift_y, target, target_x, target_y))
+            return t;
+    }
+    return -1.0;
+}
+
+// Free the mask bits
+void free_collision_mask(CollisionMask* mask) {
+    if (!mask)
+        return;
+    FreeNoLog(mask->bits);
+    mask->capacity = 0;
+    mask->width = mask->height = mask->words = 0;
+}
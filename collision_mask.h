@@ -0,0 +1,53 @@
+/**\file collision_mask.h
+ *  packed 1 bit alpha masks for pixel accurate collisions for hacks
+ *\author Castagnier Mickaël aka Gull Ra Driel
+ *\version 1.0
+ *\date 16/10/2026
+ */
+
+#ifndef COLLISION_MASK_HEADER_FOR_HACKS
+#define COLLISION_MASK_HEADER_FOR_HACKS
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <allegro5/allegro.h>
+
+// Pixels with at least that alpha are solid
+#define COLLISION_MASK_ALPHA 128
+// Largest distance in pixels a mask corner may move by between two poses of swept_mask_collision
+#define MASK_SWEEP_STEP 1.0
+
+// Solid pixels of a bitmap, one bit each: pixel x of row y is bit x % 64 of bits[y * words + x / 64].
+// The bits past width are always clear, so rows can be ANDed word by word
+typedef struct {
+    int width, height;  // Size in pixels
+    int words;          // 64 bit words per row
+    int x, y;           // World position of the top-left pixel, set for placed masks
+    uint64_t* bits;     // height rows of words words
+    int capacity;       // Allocated words, a placed mask is reused while it is large enough
+} CollisionMask;
+
+// Build the mask of a bitmap, pixels with an alpha of at least alpha_threshold being solid. Locks the bitmap, call at load time
+bool build_collision_mask(CollisionMask* mask, ALLEGRO_BITMAP* bitmap, int alpha_threshold);
+// Fill placed with the part inside the clip rectangle of src rotated by angle around (cx, cy) and drawn at (dx, dy),
+// as al_draw_rotated_bitmap would. Returns false if nothing is left after clipping
+bool place_collision_mask(CollisionMask* placed, const CollisionMask* src, double cx, double cy, double dx, double dy, double angle, int clip_x, int clip_y, int clip_w, int clip_h);
+// true if a mask at (ax, ay) and a mask at (bx, by) have a solid pixel in common
+bool collision_masks_overlap(const CollisionMask* a, int ax, int ay, const CollisionMask* b, int bx, int by);
+// first time in [from, 1] at which a mask moving from (x0, y0, angle0) to (x1, y1, angle1) around (cx, cy) has a solid pixel in
+// common with the target mask at (target_x, target_y), or -1. Poses are at most MASK_SWEEP_STEP pixels apart, however long
+// the move. placed is a scratch mask reused between calls
+double swept_mask_collision(CollisionMask* placed, const CollisionMask* mover, double cx, double cy, double x0, double y0, double angle0, double x1, double y1, double angle1, double from, const CollisionMask* target, int target_x, int target_y);
+// Free the mask bits
+void free_collision_mask(CollisionMask* mask);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,29 @@
+#include "game_random.h"
+
+// splitmix64 state of each stream
+static uint64_t random_streams[RANDOM_STREAMS] = {0};
+static uint64_t random_seed = 0;
+
+// Seed every stream, spacing their starting points by the splitmix64 increment
+void seed_game_random(uint64_t seed) {
+    random_seed = seed;
+    for (int it = 0; it < RANDOM_STREAMS; it++) {
+        random_streams[it] = seed + (uint64_t)(it + 1) * 0xD1B54A32D192ED03ULL;
+    }
+}
+
+// Get the current seed
+uint64_t get_game_random_seed(void) {
+    return random_seed;
+}
+
+// splitmix64 step
+int game_rand(int stream) {
+    if (stream < 0 || stream >= RANDOM_STREAMS)
+        stream = 0;
+    uint64_t z = (random_streams[stream] += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z = z ^ (z >> 31);
+    return (int)(z >> 33);
+}
@@ -0,0 +1,40 @@
+/**\file game_random.h
+ *  seeded random streams for hacks
+ *\author Castagnier Mickaël aka Gull Ra Driel
+ *\version 1.0
+ *\date 16/10/2026
+ */
+
+#ifndef GAME_RANDOM_HEADER_FOR_HACKS
+#define GAME_RANDOM_HEADER_FOR_HACKS
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+// Largest value returned by game_rand
+#define GAME_RAND_MAX 0x7FFFFFFF
+
+// One independent stream per subsystem, so that a change in the number of draws
+// of one subsystem does not shift the values seen by the others
+enum GAME_RANDOM_STREAMS {
+    RANDOM_WORLD,      // Objects placement and icons
+    RANDOM_PARTICLES,  // Particles positions, speeds and colors
+    RANDOM_AUTOPILOT,  // Headless autopilot inputs
+    RANDOM_STREAMS     // Number of streams
+};
+
+// Seed every stream from a single value
+void seed_game_random(uint64_t seed);
+// Get the seed given to seed_game_random
+uint64_t get_game_random_seed(void);
+// Next value of a stream, between 0 and GAME_RAND_MAX, a drop-in replacement for rand()
+int game_rand(int stream);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
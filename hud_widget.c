@@ -0,0 +1,77 @@
+#include "hud_widget.h"
+#include <stdio.h>
+#include <string.h>
+
+// Set up a field, nothing is rendered before its first draw
+void init_hud_field(HudField* field, ALLEGRO_FONT* font, ALLEGRO_COLOR color, float x, float y, int flags, const char* format) {
+    memset(field, 0, sizeof(HudField));
+    field->font = font;
+    field->color = color;
+    field->format = format;
+    field->x = x;
+    field->y = y;
+    field->flags = flags;
+    field->rendered = false;
+}
+
+// Format the text and draw it in the field bitmap, growing the bitmap if it is too small
+static void render_hud_field(HudField* field, int value) {
+    snprintf(field->text, HUD_TEXT_SIZE, field->format, value);
+    field->value = value;
+    field->rendered = true;
+
+    int bbx = 0, bby = 0, bbw = 0, bbh = 0;
+    al_get_text_dimensions(field->font, field->text, &bbx, &bby, &bbw, &bbh);
+    field->width = bbw;
+    field->height = bbh;
+    if (bbw <= 0 || bbh <= 0)
+        return;  // Nothing to draw
+
+    if (field->bitmap && (al_get_bitmap_width(field->bitmap) < bbw || al_get_bitmap_height(field->bitmap) < bbh)) {
+        al_destroy_bitmap(field->bitmap);
+        field->bitmap = NULL;
+    }
+    if (!field->bitmap) {
+        field->bitmap = al_create_bitmap(bbw, bbh);
+        if (!field->bitmap)
+            return;  // Drawn with al_draw_text
+    }
+
+    // Bitmap top left corner, relative to the anchor
+    float text_x = 0;
+    if (field->flags & ALLEGRO_ALIGN_RIGHT)
+        text_x = -al_get_text_width(field->font, field->text);
+    else if (field->flags & ALLEGRO_ALIGN_CENTER)
+        text_x = -al_get_text_width(field->font, field->text) / 2.0f;
+    field->offset_x = text_x + bbx;
+    field->offset_y = bby;
+
+    ALLEGRO_STATE state;
+    al_store_state(&state, ALLEGRO_STATE_TARGET_BITMAP);
+    al_set_target_bitmap(field->bitmap);
+    al_clear_to_color(al_map_rgba(0, 0, 0, 0));
+    al_draw_text(field->font, field->color, -bbx, -bby, ALLEGRO_ALIGN_LEFT, field->text);
+    al_restore_state(&state);
+}
+
+// Draw the field, rendering its text again only if value changed
+void draw_hud_field(HudField* field, int value) {
+    if (!field->rendered || value != field->value)
+        render_hud_field(field, value);
+
+    if (field->width <= 0 || field->height <= 0)
+        return;
+    if (field->bitmap) {
+        al_draw_bitmap_region(field->bitmap, 0, 0, field->width, field->height, field->x + field->offset_x, field->y + field->offset_y, 0);
+    } else {
+        al_draw_text(field->font, field->color, field->x, field->y, field->flags, field->text);
+    }
+}
+
+// Free the field bitmap
+void free_hud_field(HudField* field) {
+    if (field->bitmap)
+        al_destroy_bitmap(field->bitmap);
+    field->bitmap = NULL;
+    field->rendered = false;
+}
@@ -0,0 +1,50 @@
+/**\file hud_widget.h
+ *  HUD texts rendered only when their value changes for hacks
+ *\author Castagnier Mickaël aka Gull Ra Driel
+ *\version 1.0
+ *\date 16/10/2026
+ */
+
+#ifndef HUD_WIDGET_HEADER_FOR_HACKS
+#define HUD_WIDGET_HEADER_FOR_HACKS
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_font.h>
+
+// Longest HUD text
+#define HUD_TEXT_SIZE 64
+
+// A HUD text showing one integer, kept in a bitmap redrawn only when the integer changes
+typedef struct {
+    ALLEGRO_FONT* font;        // Font to render text
+    ALLEGRO_COLOR color;       // Text color
+    const char* format;        // printf format taking the integer
+    float x, y;                // Anchor, as for al_draw_text
+    int flags;                 // ALLEGRO_ALIGN_LEFT, ALLEGRO_ALIGN_CENTER or ALLEGRO_ALIGN_RIGHT
+    int value;                 // Value of the rendered text
+    bool rendered;             // false until the first draw
+    char text[HUD_TEXT_SIZE];  // Rendered text
+    ALLEGRO_BITMAP* bitmap;    // Rendered text, reused while it is large enough. NULL to draw the text directly
+    int width, height;         // Used part of the bitmap
+    float offset_x;            // Bitmap position relative to the anchor
+    float offset_y;            // Bitmap position relative to the anchor
+} HudField;
+
+// Set up a field, drawn at x, y with the given alignment flags
+void init_hud_field(HudField* field, ALLEGRO_FONT* font, ALLEGRO_COLOR color, float x, float y, int flags, const char* format);
+// Draw the field showing value, rendering its text again only if value changed
+void draw_hud_field(HudField* field, int value);
+// Free the field bitmap
+void free_hud_field(HudField* field);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
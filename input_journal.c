@@ -0,0 +1,167 @@
+#include "input_journal.h"
+#include <string.h>
+#include "nilorea/n_common.h"
+#include "nilorea/n_log.h"
+
+// File layout, in host byte order:
+// magic[4] version(u32) seed(u64) logic_fps(f64) width height nb_good nb_bad(i32) world_width world_height(i64) nb_ticks(u32)
+// then runs of mask(u32) run_length(u32) until the end of the file
+
+// Offset of nb_ticks in the file, patched on close
+#define INPUT_JOURNAL_TICKS_OFFSET (4 + 4 + 8 + 8 + 4 * 4 + 2 * 8)
+
+// Write or read a header field, bailing out on error
+#define JOURNAL_WRITE(__field) \
+    if (fwrite(&(__field), sizeof(__field), 1, journal->file) != 1) goto io_error;
+#define JOURNAL_READ(__field) \
+    if (fread(&(__field), sizeof(__field), 1, journal->file) != 1) goto io_error;
+
+// Create a journal file and write its header
+bool open_input_journal_record(InputJournal* journal, const char* filename, const InputJournalHeader* header) {
+    __n_assert(journal, return false);
+    __n_assert(filename, return false);
+    __n_assert(header, return false);
+
+    memset(journal, 0, sizeof(InputJournal));
+    journal->file = fopen(filename, "wb");
+    if (!journal->file) {
+        n_log(LOG_ERR, "could not create input journal %s", filename);
+        return false;
+    }
+    journal->recording = true;
+    journal->header = *header;
+    journal->header.nb_ticks = 0;
+
+    uint32_t version = INPUT_JOURNAL_VERSION;
+    if (fwrite(INPUT_JOURNAL_MAGIC, 4, 1, journal->file) != 1) goto io_error;
+    JOURNAL_WRITE(version);
+    JOURNAL_WRITE(journal->header.seed);
+    JOURNAL_WRITE(journal->header.logic_fps);
+    JOURNAL_WRITE(journal->header.width);
+    JOURNAL_WRITE(journal->header.height);
+    JOURNAL_WRITE(journal->header.nb_good_presents);
+    JOURNAL_WRITE(journal->header.nb_bad_presents);
+    JOURNAL_WRITE(journal->header.world_width);
+    JOURNAL_WRITE(journal->header.world_height);
+    JOURNAL_WRITE(journal->header.nb_ticks);
+    return true;
+
+io_error:
+    n_log(LOG_ERR, "could not write input journal %s header", filename);
+    fclose(journal->file);
+    journal->file = NULL;
+    return false;
+}
+
+// Open a journal file and read its header
+bool open_input_journal_replay(InputJournal* journal, const char* filename) {
+    __n_assert(journal, return false);
+    __n_assert(filename, return false);
+
+    memset(journal, 0, sizeof(InputJournal));
+    journal->file = fopen(filename, "rb");
+    if (!journal->file) {
+        n_log(LOG_ERR, "could not open input journal %s", filename);
+        return false;
+    }
+
+    char magic[4];
+    uint32_t version = 0;
+    if (fread(magic, 4, 1, journal->file) != 1) goto io_error;
+    JOURNAL_READ(version);
+    if (memcmp(magic, INPUT_JOURNAL_MAGIC, 4) != 0 || version != INPUT_JOURNAL_VERSION) {
+        n_log(LOG_ERR, "%s is not a version %d input journal", filename, INPUT_JOURNAL_VERSION);
+        fclose(journal->file);
+        journal->file = NULL;
+        return false;
+    }
+    JOURNAL_READ(journal->header.seed);
+    JOURNAL_READ(journal->header.logic_fps);
+    JOURNAL_READ(journal->header.width);
+    JOURNAL_READ(journal->header.height);
+    JOURNAL_READ(journal->header.nb_good_presents);
+    JOURNAL_READ(journal->header.nb_bad_presents);
+    JOURNAL_READ(journal->header.world_width);
+    JOURNAL_READ(journal->header.world_height);
+    JOURNAL_READ(journal->header.nb_ticks);
+    if (journal->header.nb_ticks == 0) {
+        // the header is patched on close: the recording did not end cleanly
+        n_log(LOG_ERR, "%s has no recorded ticks, was its recording interrupted ?", filename);
+        fclose(journal->file);
+        journal->file = NULL;
+        return false;
+    }
+    return true;
+
+io_error:
+    n_log(LOG_ERR, "could not read input journal %s header", filename);
+    fclose(journal->file);
+    journal->file = NULL;
+    return false;
+}
+
+// Write the current run
+static bool flush_input_run(InputJournal* journal) {
+    if (journal->run_length == 0)
+        return true;
+    JOURNAL_WRITE(journal->mask);
+    JOURNAL_WRITE(journal->run_length);
+    journal->run_length = 0;
+    return true;
+
+io_error:
+    n_log(LOG_ERR, "could not write input journal run");
+    return false;
+}
+
+// Extend the current run, or start a new one when the keys changed
+bool record_input_tick(InputJournal* journal, uint32_t mask) {
+    __n_assert(journal, return false);
+    if (!journal->file || !journal->recording)
+        return false;
+
+    if (journal->run_length > 0 && (mask != journal->mask || journal->run_length == UINT32_MAX)) {
+        if (!flush_input_run(journal))
+            return false;
+    }
+    journal->mask = mask;
+    journal->run_length++;
+    journal->ticks++;
+    return true;
+}
+
+// Consume a tick of the current run, reading the next one when it is over
+bool replay_input_tick(InputJournal* journal, uint32_t* mask) {
+    __n_assert(journal, return false);
+    __n_assert(mask, return false);
+    if (!journal->file || journal->recording)
+        return false;
+
+    while (journal->run_length == 0) {
+        if (fread(&journal->mask, sizeof(journal->mask), 1, journal->file) != 1 ||
+            fread(&journal->run_length, sizeof(journal->run_length), 1, journal->file) != 1)
+            return false;
+    }
+    journal->run_length--;
+    journal->ticks++;
+    (*mask) = journal->mask;
+    return true;
+}
+
+// Close the journal, completing the header of a recording
+void close_input_journal(InputJournal* journal) {
+    if (!journal || !journal->file)
+        return;
+
+    if (journal->recording) {
+        flush_input_run(journal);
+        journal->header.nb_ticks = journal->ticks;
+        if (fseek(journal->file, INPUT_JOURNAL_TICKS_OFFSET, SEEK_SET) == 0) {
+            JOURNAL_WRITE(journal->header.nb_ticks);
+        }
+        n_log(LOG_INFO, "input journal: %u ticks recorded", journal->ticks);
+    }
+io_error:
+    fclose(journal->file);
+    journal->file = NULL;
+}
@@ -0,0 +1,60 @@
+/**\file input_journal.h
+ *  input recording and replay for hacks
+ *\author Castagnier Mickaël aka Gull Ra Driel
+ *\version 1.0
+ *\date 16/10/2026
+ */
+
+#ifndef INPUT_JOURNAL_HEADER_FOR_HACKS
+#define INPUT_JOURNAL_HEADER_FOR_HACKS
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// File signature and format version
+#define INPUT_JOURNAL_MAGIC "GDJ1"
+#define INPUT_JOURNAL_VERSION 1
+
+// Everything needed to rebuild the same world before replaying the inputs
+typedef struct {
+    uint64_t seed;            // Seed given to seed_game_random
+    double logic_fps;         // Logic ticks per second
+    int32_t width, height;    // Screen size, used by the world limits
+    int32_t nb_good_presents; // Number of gifts
+    int32_t nb_bad_presents;  // Number of Krampus items
+    int64_t world_width;      // World size
+    int64_t world_height;
+    uint32_t nb_ticks;        // Number of recorded ticks, written when the journal is closed
+} InputJournalHeader;
+
+// Journal file. Inputs are stored as runs: a key mask and the number of ticks it was held
+typedef struct {
+    FILE* file;                 // Journal file
+    bool recording;             // true when recording, false when replaying
+    InputJournalHeader header;  // Session parameters
+    uint32_t mask;              // Key mask of the current run
+    uint32_t run_length;        // Remaining (replay) or accumulated (record) ticks of the current run
+    uint32_t ticks;             // Ticks recorded or replayed so far
+} InputJournal;
+
+// Create a journal file and write its header
+bool open_input_journal_record(InputJournal* journal, const char* filename, const InputJournalHeader* header);
+// Open a journal file and read its header. Fails if the header has no ticks, as when the recording was not closed
+bool open_input_journal_replay(InputJournal* journal, const char* filename);
+// Record the key mask of a tick
+bool record_input_tick(InputJournal* journal, uint32_t mask);
+// Read the key mask of the next tick. Returns false at the end of the journal
+bool replay_input_tick(InputJournal* journal, uint32_t* mask);
+// Write the pending run and the number of ticks, then close the file
+void close_input_journal(InputJournal* journal);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
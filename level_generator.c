@@ -0,0 +1,75 @@
+#include "level_generator.h"
+#include <math.h>
+#include <stdlib.h>
+#include "game_random.h"
+#include "nilorea/n_common.h"
+#include "nilorea/n_log.h"
+
+// Random double in [0, 1[, from the world stream
+static double random_unit(void) {
+    return game_rand(RANDOM_WORLD) / ((double)GAME_RAND_MAX + 1.0);
+}
+
+// Random int in [0, max[, for ranges larger than RAND_MAX
+static int random_index(int max) {
+    return (int)(random_unit() * max);
+}
+
+// Generate nb_points spread positions.
+// Two points of different cells are at least a cell size minus the margins, min_dist, apart on one axis,
+// so candidates never need to be checked against each other
+int jittered_grid_sampling(double x, double y, double w, double h, double min_dist, int nb_points, Vector* points) {
+    __n_assert(points, return 0);
+    if (nb_points <= 0 || w <= 0.0 || h <= 0.0 || min_dist <= 0.0)
+        return 0;
+
+    // largest cells giving nb_points of them
+    double cell_size = sqrt(w * h / nb_points);
+    int cols = (int)(w / cell_size);
+    int rows = (int)(h / cell_size);
+    while ((int64_t)cols * rows < nb_points && cell_size > min_dist) {
+        cell_size *= 0.99;
+        if (cell_size < min_dist)
+            cell_size = min_dist;
+        cols = (int)(w / cell_size);
+        rows = (int)(h / cell_size);
+    }
+    if (cell_size < min_dist) {
+        cell_size = min_dist;
+        cols = (int)(w / cell_size);
+        rows = (int)(h / cell_size);
+    }
+    if (cols < 1 || rows < 1)
+        return 0;
+
+    int nb_cells = cols * rows;
+    if (nb_points > nb_cells) {
+        n_log(LOG_ERR, "jittered grid: only %d/%d points fit in %gx%g with a spacing of %g", nb_cells, nb_points, w, h, min_dist);
+        nb_points = nb_cells;
+    }
+
+    // pick nb_points distinct cells with a partial shuffle
+    int* cells = NULL;
+    Malloc(cells, int, nb_cells);
+    __n_assert(cells, return 0);
+    for (int i = 0; i < nb_cells; i++)
+        cells[i] = i;
+
+    // spread the unused space evenly around the grid
+    double start_x = x + (w - cols * cell_size) / 2.0;
+    double start_y = y + (h - rows * cell_size) / 2.0;
+    double jitter = cell_size - min_dist;
+
+    for (int i = 0; i < nb_points; i++) {
+        int j = i + random_index(nb_cells - i);
+        int cell = cells[j];
+        cells[j] = cells[i];
+        cells[i] = cell;
+
+        points[i].x = start_x + (cell % cols) * cell_size + min_dist / 2.0 + random_unit() * jitter;
+        points[i].y = start_y + (cell / cols) * cell_size + min_dist / 2.0 + random_unit() * jitter;
+    }
+    Free(cells);
+
+    return nb_points;
+}
@@ -0,0 +1,27 @@
+/**\file level_generator.h
+ *  objects placement for hacks
+ *\author Castagnier Mickaël aka Gull Ra Driel
+ *\version 1.0
+ *\date 16/10/2026
+ */
+
+#ifndef LEVEL_GENERATOR_HEADER_FOR_HACKS
+#define LEVEL_GENERATOR_HEADER_FOR_HACKS
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "sledge_physics.h"
+
+// Fill points with up to nb_points random positions inside (x, y, w, h), at least min_dist apart.
+// The area is split in cells as large as possible, nb_points of them are picked at random and hold
+// one point each, jittered inside its cell with a min_dist / 2 margin to the cell borders.
+// Returns the number of points generated, lower than nb_points if the area is too small
+int jittered_grid_sampling(double x, double y, double w, double h, double min_dist, int nb_points, Vector* points);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,77 @@
+#include "music_player.h"
+#include <string.h>
+#include "nilorea/n_common.h"
+#include "nilorea/n_log.h"
+
+// Set up the player on a playlist
+bool init_music_player(MusicPlayer* player, char** tracks, int buffer_count, int buffer_samples) {
+    __n_assert(player, return false);
+
+    memset(player, 0, sizeof(MusicPlayer));
+    player->tracks = tracks;
+    while (tracks && tracks[player->nb_tracks])
+        player->nb_tracks++;
+    player->current = -1;
+    player->buffer_count = (buffer_count > 0) ? (size_t)buffer_count : MUSIC_BUFFER_COUNT;
+    player->buffer_samples = (buffer_samples > 0) ? (unsigned int)buffer_samples : MUSIC_BUFFER_SAMPLES;
+    return true;
+}
+
+// Destroy the current stream
+static void stop_music_stream(MusicPlayer* player) {
+    if (!player->stream)
+        return;
+    al_set_audio_stream_playing(player->stream, false);
+    al_destroy_audio_stream(player->stream);
+    player->stream = NULL;
+}
+
+// Stream the tracks following the current one until one can be loaded, trying each track once
+static bool play_next_track(MusicPlayer* player) {
+    stop_music_stream(player);
+    for (int tries = 0; tries < player->nb_tracks; tries++) {
+        player->current = (player->current + 1) % player->nb_tracks;
+        const char* track = player->tracks[player->current];
+        ALLEGRO_AUDIO_STREAM* stream = al_load_audio_stream(track, player->buffer_count, player->buffer_samples);
+        if (!stream) {
+            n_log(LOG_ERR, "could not stream %s", track);
+            continue;
+        }
+        al_set_audio_stream_playmode(stream, (player->nb_tracks == 1) ? ALLEGRO_PLAYMODE_LOOP : ALLEGRO_PLAYMODE_ONCE);
+        if (!al_attach_audio_stream_to_mixer(stream, al_get_default_mixer())) {
+            n_log(LOG_ERR, "could not attach %s to the default mixer", track);
+            al_destroy_audio_stream(stream);
+            continue;
+        }
+        player->stream = stream;
+        n_log(LOG_INFO, "streaming %s, %zu buffers of %u samples", track, player->buffer_count, player->buffer_samples);
+        return true;
+    }
+    return false;
+}
+
+// Start streaming the first track that can be loaded
+bool start_music_player(MusicPlayer* player) {
+    __n_assert(player, return false);
+    if (player->nb_tracks == 0)
+        return false;
+
+    player->current = -1;
+    return play_next_track(player);
+}
+
+// Move on to the next track once the current one ended
+void update_music_player(MusicPlayer* player) {
+    if (!player || !player->stream)
+        return;
+    if (!al_get_audio_stream_playing(player->stream))
+        play_next_track(player);
+}
+
+// Stop and destroy the stream
+void free_music_player(MusicPlayer* player) {
+    if (!player)
+        return;
+    stop_music_stream(player);
+    player->current = -1;
+}
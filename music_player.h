@@ -0,0 +1,48 @@
+/**\file music_player.h
+ *  streamed background music playlist for hacks
+ *\author Castagnier Mickaël aka Gull Ra Driel
+ *\version 1.0
+ *\date 16/10/2026
+ */
+
+#ifndef MUSIC_PLAYER_HEADER_FOR_HACKS
+#define MUSIC_PLAYER_HEADER_FOR_HACKS
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "allegro5/allegro_audio.h"
+
+// Default number of stream fragments
+#define MUSIC_BUFFER_COUNT 4
+// Default number of samples per fragment
+#define MUSIC_BUFFER_SAMPLES 2048
+
+// Playlist decoded on the fly: only buffer_count fragments of buffer_samples samples are held in memory
+typedef struct {
+    char** tracks;                 // NULL terminated list of files, owned by the caller
+    int nb_tracks;                 // Number of tracks
+    int current;                   // Index of the track being played
+    size_t buffer_count;           // Number of stream fragments
+    unsigned int buffer_samples;   // Samples per fragment
+    ALLEGRO_AUDIO_STREAM* stream;  // Stream of the current track, NULL when nothing plays
+} MusicPlayer;
+
+// Set up the player on a playlist, buffer_count and buffer_samples falling back to the defaults when not positive
+bool init_music_player(MusicPlayer* player, char** tracks, int buffer_count, int buffer_samples);
+// Start streaming the first track that can be loaded. A single track loops, a playlist plays in turn and wraps
+bool start_music_player(MusicPlayer* player);
+// Move on to the next track once the current one ended, to call regularly from the display thread
+void update_music_player(MusicPlayer* player);
+// Stop and destroy the stream
+void free_music_player(MusicPlayer* player);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
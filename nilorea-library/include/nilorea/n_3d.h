@@ -28,6 +28,13 @@ extern "C" {
 /*! PHYSICS object state for move simulated from latest update */
 #define MOVE_SIMU 2
 
+/*! batch integrator path: plain C loop */
+#define PHYSICS_BATCH_SCALAR 0
+/*! batch integrator path: SSE2, two components per instruction */
+#define PHYSICS_BATCH_SSE2 1
+/*! batch integrator path: AVX2, four components per instruction */
+#define PHYSICS_BATCH_AVX2 2
+
 /*! value when the two VECTOR3D are not connected */
 #define VECTOR3D_DONT_INTERSECT -2
 /*! value when the two VECTOR3D are collinear */
@@ -80,6 +87,10 @@ int update_physics_position_reverse_nb(PHYSICS* object, int it, double delta_t);
 int update_physics_position(PHYSICS* object, double delta_t);
 /* update the position of an object, using the delta time T to reverse update positions */
 int update_physics_position_reverse(PHYSICS* object, double delta_t);
+/* update nb packed position/speed componants in one pass, using the fastest path supported by the cpu */
+int update_physics_position_batch(double* position, double* speed, const double* acceleration, const double* gravity, double* angular_speed, const double* angular_acceleration, size_t nb, double delta_t);
+/* get the batch integrator path selected for the running cpu */
+int get_physics_batch_path(void);
 /* compute if two vector are colliding, storing the resulting point in px */
 int vector_intersect(VECTOR3D* p0, VECTOR3D* p1, VECTOR3D* p2, VECTOR3D* p3, VECTOR3D* px);
 /* dot product */
@@ -29,6 +29,7 @@ extern "C" {
 #include "n_list.h"
 #include "n_3d.h"
 #include "n_time.h"
+#include "n_thread_pool.h"
 
 /*! classic moving particle */
 #define NORMAL_PART 0
@@ -70,10 +71,107 @@ typedef struct PARTICLE {
 
 } PARTICLE;
 
-/*! Structure of a particle system */
+/*! maximum number of ranges manage_particle_threaded splits the particles into */
+#define PARTICLE_MAX_THREAD_JOBS 64
+/*! minimum number of particles in a manage_particle_threaded range */
+#define PARTICLE_MIN_THREAD_RANGE 1024
+
+/*! duration of a timing wheel slot, in lifetime units. Particles expire at the end of the slot holding their expiry time */
+#define PARTICLE_WHEEL_GRANULARITY 1024
+/*! number of bits of the first timing wheel level */
+#define PARTICLE_WHEEL_L0_BITS 8
+/*! number of bits of each upper timing wheel level */
+#define PARTICLE_WHEEL_LN_BITS 6
+/*! number of upper timing wheel levels */
+#define PARTICLE_WHEEL_UPPER_LEVELS 3
+/*! total number of timing wheel buckets */
+#define PARTICLE_WHEEL_BUCKETS ((1 << PARTICLE_WHEEL_L0_BITS) + PARTICLE_WHEEL_UPPER_LEVELS * (1 << PARTICLE_WHEEL_LN_BITS))
+
+/*! number of segments of a batched circle particle */
+#define PARTICLE_CIRCLE_SEGMENTS 12
+
+/*! Description of a burst of particles for add_particles_batch. Each randomized value is picked in [ base, base + range ] */
+typedef struct PARTICLE_EMITTER {
+    /*! sprite id in library, negative for none */
+    int spr_id;
+    /*! particle mode: NORMAL_PART,SINUS_PART,PIXEL_PART */
+    int mode;
+    /*! base lifetime */
+    int lifetime;
+    /*! lifetime random range */
+    int lifetime_range;
+    /*! base size */
+    int size;
+    /*! size random range */
+    int size_range;
+    /*! base color */
+    ALLEGRO_COLOR color;
+    /*! random range of each color channel */
+    ALLEGRO_COLOR color_range;
+    /*! base physics: position, speed, acceleration, gravity, orientation */
+    PHYSICS object;
+    /*! x,y,z position random range */
+    VECTOR3D position_range;
+    /*! vx,vy,vz speed random range */
+    VECTOR3D speed_range;
+} PARTICLE_EMITTER;
+
+/*! Structure of a particle system. Particles are stored as a structure of arrays: each property lives in its own dense array indexed from 0 to nb_particles - 1, dead particles are swap-removed */
 typedef struct PARTICLE_SYSTEM {
-    /*! list of PARTICLE pointers */
-    LIST* list;
+    /*! number of live particles */
+    int nb_particles;
+    /*! maximum number of particles, zero or negative for unlimited */
+    int nb_max_particles;
+    /*! number of allocated slots in each array */
+    int capacity;
+
+    /*! particles modes: NORMAL_PART,SINUS_PART,PIXEL_PART */
+    int* mode;
+    /*! particles lifetimes, as given at creation. -1 for immortal particles */
+    int* lifetime;
+    /*! particles sprite id in library */
+    int* spr_id;
+    /*! particles sizes */
+    int* size;
+    /*! particles colors */
+    ALLEGRO_COLOR* color;
+
+    /*! particles x,y,z positions */
+    VECTOR3D* position;
+    /*! particles x,y,z positions before the last update, for draw interpolation */
+    VECTOR3D* previous_position;
+    /*! particles vx,vy,vz speeds */
+    VECTOR3D* speed;
+    /*! particles ax,ay,az accelerations */
+    VECTOR3D* acceleration;
+    /*! particles gx,gy,gz gravity */
+    VECTOR3D* gravity;
+    /*! particles rotation positions */
+    VECTOR3D* orientation;
+    /*! particles angular speeds */
+    VECTOR3D* angular_speed;
+    /*! particles angular accelerations */
+    VECTOR3D* angular_acceleration;
+
+    /*! Internal: particles expiry tick in the timing wheel */
+    int64_t* wheel_expire;
+    /*! Internal: particles timing wheel bucket, -1 if not in the wheel */
+    int* wheel_bucket;
+    /*! Internal: next particle in the same timing wheel bucket, -1 at the end */
+    int* wheel_next;
+    /*! Internal: previous particle in the same timing wheel bucket, -1 at the start */
+    int* wheel_prev;
+    /*! Internal: first particle of each timing wheel bucket, -1 if empty */
+    int wheel_head[PARTICLE_WHEEL_BUCKETS];
+    /*! Internal: current timing wheel tick */
+    int64_t wheel_tick;
+    /*! Internal: elapsed time in lifetime units */
+    double clock;
+    /*! Internal: state of the random generator used by batched emissions */
+    uint64_t random_state;
+
+    /*! draw_particle position blend between previous_position (0.0) and position (1.0) */
+    double interpolation;
 
     /*! Coordinate of emitting point */
     VECTOR3D source;
@@ -85,23 +183,98 @@ typedef struct PARTICLE_SYSTEM {
     ALLEGRO_BITMAP** sprites;
     /*! size of the picture library */
     int max_sprites;
+
+    /*! Internal: vertex buffer of the quad particles, 4 vertices per quad */
+    ALLEGRO_VERTEX* quad_vertices;
+    /*! Internal: index buffer of the quad particles, filled once and reused */
+    int* quad_indices;
+    /*! Internal: number of quads the quad buffers can hold */
+    int quad_capacity;
+    /*! Internal: vertex buffer of the circle particles, triangle list */
+    ALLEGRO_VERTEX* circle_vertices;
+    /*! Internal: number of circles the circle buffer can hold */
+    int circle_capacity;
 } PARTICLE_SYSTEM;
 
+/*! maximum number of categories of a particle governor */
+#define PARTICLE_MAX_CATEGORIES 16
+/*! weight of the last measure in the smoothed governor cost */
+#define PARTICLE_GOVERNOR_SMOOTHING 0.1
+/*! quality factor applied on each update while over budget */
+#define PARTICLE_GOVERNOR_DECREASE 0.95
+/*! quality added on each update while under PARTICLE_GOVERNOR_RECOVER of the budget */
+#define PARTICLE_GOVERNOR_INCREASE 0.01
+/*! fraction of the budget under which the quality goes back up */
+#define PARTICLE_GOVERNOR_RECOVER 0.8
+/*! lowest quality */
+#define PARTICLE_GOVERNOR_MIN_QUALITY 0.05
+
+/*! Emission budget of a category of particles */
+typedef struct PARTICLE_CATEGORY {
+    /*! priority, from 0 for ambient particles. A category is throttled only once the quality drops under 1 / ( 1 + priority ) */
+    int priority;
+    /*! rate the category never goes under, 1.0 for particles that are never throttled */
+    double min_rate;
+    /*! hard cap on the particles emitted between two governor updates, zero or negative for none */
+    int max_per_update;
+    /*! Internal: part of the requested particles currently emitted */
+    double rate;
+    /*! Internal: fraction of particle carried over to the next emission */
+    double carry;
+    /*! Internal: particles emitted since the last governor update */
+    int emitted;
+    /*! Internal: fraction of the system nb_max_particles the category may fill, from its priority */
+    double fill_limit;
+} PARTICLE_CATEGORY;
+
+/*! Adaptive emission governor: scales the emissions of each category so that the measured particles cost stays in a budget */
+typedef struct PARTICLE_GOVERNOR {
+    /*! governed particle system, its nb_max_particles being the hard cap on live particles */
+    PARTICLE_SYSTEM* psys;
+    /*! cost budget, in the unit of the measures given to update_particle_governor. Zero or negative to never throttle */
+    double budget;
+    /*! smoothed measured cost */
+    double cost;
+    /*! global quality, from PARTICLE_GOVERNOR_MIN_QUALITY to 1.0 */
+    double quality;
+    /*! number of categories */
+    int nb_categories;
+    /*! categories */
+    PARTICLE_CATEGORY categories[PARTICLE_MAX_CATEGORIES];
+} PARTICLE_GOVERNOR;
+
 int init_particle_system(PARTICLE_SYSTEM** psys, int max, double x, double y, double z, int max_sprites);
 
+int reserve_particles(PARTICLE_SYSTEM* psys, int capacity);
+int seed_particle_system(PARTICLE_SYSTEM* psys, uint64_t seed);
+
 int add_particle(PARTICLE_SYSTEM* psys, int spr, int mode, int lifetime, int size, ALLEGRO_COLOR color, PHYSICS object);
+int add_particles_batch(PARTICLE_SYSTEM* psys, int count, const PARTICLE_EMITTER* emitter);
 int add_particle_ex(PARTICLE_SYSTEM* psys, int spr, int mode, int off_x, int off_y, int lifetime, int size, ALLEGRO_COLOR color, double vx, double vy, double vz, double ax, double ay, double az);
 
 int manage_particle_ex(PARTICLE_SYSTEM* psys, double delta_t);
 
 int manage_particle(PARTICLE_SYSTEM* psys);
 
+int manage_particle_threaded(PARTICLE_SYSTEM* psys, THREAD_POOL* thread_pool, double delta_t);
+
+int set_particle_interpolation(PARTICLE_SYSTEM* psys, double alpha);
+
 int draw_particle(PARTICLE_SYSTEM* psys, double xpos, double ypos, int w, int h, double range);
 
+int copy_visible_particles(PARTICLE_SYSTEM* dst, const PARTICLE_SYSTEM* src, double xpos, double ypos, int w, int h, double range);
+
 int free_particle_system(PARTICLE_SYSTEM** psys);
 
 int move_particles(PARTICLE_SYSTEM* psys, double vx, double vy, double vz);
 
+int init_particle_governor(PARTICLE_GOVERNOR* gov, PARTICLE_SYSTEM* psys, double budget);
+int add_particle_category(PARTICLE_GOVERNOR* gov, int priority, double min_rate, int max_per_update);
+int update_particle_governor(PARTICLE_GOVERNOR* gov, double cost);
+int particle_governor_emit(PARTICLE_GOVERNOR* gov, int category, int requested);
+
+int remove_particle(PARTICLE_SYSTEM* psys, int index);
+
 /**
 @}
 */
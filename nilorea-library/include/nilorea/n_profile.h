@@ -0,0 +1,111 @@
+/**\file n_profile.h
+ *  Zone profiler declaration
+ *\author Castagnier Mickael
+ *\version 1.0
+ *\date 16/10/2026
+ */
+
+#ifndef NILOREA_PROFILE_LIBRARY
+#define NILOREA_PROFILE_LIBRARY
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**\defgroup PROFILE PROFILE: named zones timings, percentiles and Chrome trace export
+   \addtogroup PROFILE
+  @{
+*/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "n_time.h"
+
+/*! maximum number of zones */
+#define N_PROFILE_MAX_ZONES 64
+/*! number of timings kept per zone, older ones are overwritten */
+#define N_PROFILE_RING_SIZE 4096
+/*! maximum length of a zone name */
+#define N_PROFILE_NAME_SIZE 32
+
+/*! One timing of a zone */
+typedef struct N_PROFILE_SAMPLE {
+    /*! start, in nsecs since the profiler start */
+    int64_t start;
+    /*! duration in nsecs */
+    int64_t duration;
+    /*! id of the recording thread, in order of first record */
+    int thread;
+} N_PROFILE_SAMPLE;
+
+/*! A named zone and its last timings */
+typedef struct N_PROFILE_ZONE {
+    /*! zone name */
+    char name[N_PROFILE_NAME_SIZE];
+    /*! ring buffer of N_PROFILE_RING_SIZE timings */
+    N_PROFILE_SAMPLE* ring;
+    /*! next ring slot to write */
+    int next;
+    /*! number of valid timings in ring */
+    int nb_samples;
+} N_PROFILE_ZONE;
+
+/*! Timings summary of a zone, all durations in nsecs */
+typedef struct N_PROFILE_STATS {
+    /*! zone name */
+    const char* name;
+    /*! number of timings summarized */
+    int nb_samples;
+    /*! median duration */
+    int64_t p50;
+    /*! 95th percentile */
+    int64_t p95;
+    /*! 99th percentile */
+    int64_t p99;
+    /*! longest duration */
+    int64_t max;
+} N_PROFILE_STATS;
+
+#ifndef N_PROFILE_DISABLED
+/*! start timing the zone __zone (an identifier) until the N_PROFILE_END of the same name, in the same scope */
+#define N_PROFILE_BEGIN(__zone)                                  \
+    static int __n_profile_zone_##__zone = -1;                   \
+    if (__n_profile_zone_##__zone == -1)                         \
+        __n_profile_zone_##__zone = n_profile_zone(#__zone);     \
+    int64_t __n_profile_start_##__zone = n_profile_now();
+
+/*! record the timing of the zone __zone started by N_PROFILE_BEGIN */
+#define N_PROFILE_END(__zone) \
+    n_profile_record(__n_profile_zone_##__zone, __n_profile_start_##__zone, n_profile_now());
+#else
+#define N_PROFILE_BEGIN(__zone)
+#define N_PROFILE_END(__zone)
+#endif
+
+/* get the id of a zone, creating it on first use */
+int n_profile_zone(const char* name);
+/* nsecs elapsed since the profiler start */
+int64_t n_profile_now(void);
+/* add a timing to a zone */
+void n_profile_record(int zone, int64_t start, int64_t end);
+/* turn the recording on or off */
+void n_profile_enable(bool enabled);
+/* number of zones */
+int n_profile_nb_zones(void);
+/* summarize the timings of a zone */
+int n_profile_get_stats(int zone, N_PROFILE_STATS* stats);
+/* write all the kept timings as a Chrome trace-event JSON file */
+int n_profile_dump_trace(const char* filename);
+/* free all the zones */
+void n_profile_free(void);
+
+/**
+@}
+*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -16,6 +16,7 @@ extern "C" {
 
 #include <time.h>
 #include <limits.h>
+#include <stdint.h>
 
 #ifdef __windows__
 #include <windows.h>
@@ -28,23 +29,19 @@ extern "C" {
   @{
   */
 
+/*! N_TIME clock source: clock_gettime( CLOCK_MONOTONIC_RAW ), QueryPerformanceCounter on windows */
+#define N_TIME_CLOCK_MONOTONIC 0
+/*! N_TIME clock source: time stamp counter, calibrated against the monotonic clock. x86 with an invariant TSC only */
+#define N_TIME_CLOCK_TSC 1
+
 /*! Timing Structure */
 typedef struct N_TIME {
     /*! time since last poll */
     time_t delta;
-#ifdef __windows__
-    /*! queryperformancefrequency storage */
-    LARGE_INTEGER freq;
-    /*! start time W32*/
-    LARGE_INTEGER startTime;
-    /*! current time W32*/
-    LARGE_INTEGER currentTime;
-#else
-    /*! start time */
-    struct timeval startTime;
-    /*! start time */
-    struct timeval currentTime;
-#endif
+    /*! start time, in nsecs of the clock source */
+    int64_t startTime;
+    /*! last poll time, in nsecs of the clock source */
+    int64_t currentTime;
 } N_TIME;
 
 #if defined __windows__
@@ -56,9 +53,27 @@ void u_sleep(unsigned int usec);
 /* for the 'press a key to continue' */
 void PAUSE(void);
 
+/* Choose the clock of the N_TIME timers */
+int set_time_source(int source);
+
+/* Get the clock of the N_TIME timers */
+int get_time_source(void);
+
+/* Read the clock of the N_TIME timers, in nsec */
+int64_t get_time_nsec(void);
+
+/* Read the CPU cycle counter */
+uint64_t get_cycles(void);
+
+/* Get the calibrated cycle counter frequency */
+double get_cycles_frequency(void);
+
 /* Init or restart from zero any N_TIME HiTimer */
 int start_HiTimer(N_TIME* timer);
 
+/* Poll any N_TIME HiTimer, returning nsec */
+time_t get_nsec(N_TIME* timer);
+
 /* Poll any N_TIME HiTimer, returning usec */
 time_t get_usec(N_TIME* timer);
 
@@ -8,6 +8,11 @@
 #include "nilorea/n_3d.h"
 #include "math.h"
 
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define N_3D_HAVE_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
 /*!\fn double distance( VECTOR3D *p1 , VECTOR3D *p2 )
  *\brief compute the distance between two VECTOR3D points
  *\param p1 The first point
@@ -90,6 +95,142 @@ int update_physics_position(PHYSICS* object, double delta_t) {
     return TRUE;
 }
 
+/*!\fn static void update_physics_position_batch_scalar( double *position, double *speed, const double *acceleration, const double *gravity, double *angular_speed, const double *angular_acceleration, size_t start, size_t nb, double dt, double half_dt2 )
+ *\brief scalar batch integrator, also used for the tails of the SIMD paths
+ *\param position packed positions componants
+ *\param speed packed speeds componants
+ *\param acceleration packed accelerations componants
+ *\param gravity packed gravity componants
+ *\param angular_speed packed angular speeds componants
+ *\param angular_acceleration packed angular accelerations componants
+ *\param start first componant to update
+ *\param nb number of packed componants
+ *\param dt delta time in seconds
+ *\param half_dt2 dt * dt / 2
+ */
+static void update_physics_position_batch_scalar(double* position, double* speed, const double* acceleration, const double* gravity, double* angular_speed, const double* angular_acceleration, size_t start, size_t nb, double dt, double half_dt2) {
+    for (size_t it = start; it < nb; it++) {
+        double new_speed = speed[it] + acceleration[it] * dt;
+        position[it] = position[it] + new_speed * dt + acceleration[it] * half_dt2;
+        angular_speed[it] = angular_speed[it] + angular_acceleration[it] * dt;
+        speed[it] = new_speed + gravity[it] * dt;
+    }
+} /* update_physics_position_batch_scalar(...) */
+
+#ifdef N_3D_HAVE_X86_SIMD
+/*!\fn static void update_physics_position_batch_sse2( double *position, double *speed, const double *acceleration, const double *gravity, double *angular_speed, const double *angular_acceleration, size_t nb, double dt, double half_dt2 )
+ *\brief SSE2 batch integrator, two componants per iteration
+ *\param position packed positions componants
+ *\param speed packed speeds componants
+ *\param acceleration packed accelerations componants
+ *\param gravity packed gravity componants
+ *\param angular_speed packed angular speeds componants
+ *\param angular_acceleration packed angular accelerations componants
+ *\param nb number of packed componants
+ *\param dt delta time in seconds
+ *\param half_dt2 dt * dt / 2
+ */
+__attribute__((target("sse2"))) static void update_physics_position_batch_sse2(double* position, double* speed, const double* acceleration, const double* gravity, double* angular_speed, const double* angular_acceleration, size_t nb, double dt, double half_dt2) {
+    __m128d vdt = _mm_set1_pd(dt);
+    __m128d vhalf_dt2 = _mm_set1_pd(half_dt2);
+    size_t it = 0;
+    for (; it + 2 <= nb; it += 2) {
+        __m128d acc = _mm_loadu_pd(acceleration + it);
+        __m128d spd = _mm_add_pd(_mm_loadu_pd(speed + it), _mm_mul_pd(acc, vdt));
+        __m128d pos = _mm_add_pd(_mm_add_pd(_mm_loadu_pd(position + it), _mm_mul_pd(spd, vdt)), _mm_mul_pd(acc, vhalf_dt2));
+        __m128d ang = _mm_add_pd(_mm_loadu_pd(angular_speed + it), _mm_mul_pd(_mm_loadu_pd(angular_acceleration + it), vdt));
+        spd = _mm_add_pd(spd, _mm_mul_pd(_mm_loadu_pd(gravity + it), vdt));
+        _mm_storeu_pd(position + it, pos);
+        _mm_storeu_pd(speed + it, spd);
+        _mm_storeu_pd(angular_speed + it, ang);
+    }
+    update_physics_position_batch_scalar(position, speed, acceleration, gravity, angular_speed, angular_acceleration, it, nb, dt, half_dt2);
+} /* update_physics_position_batch_sse2(...) */
+
+/*!\fn static void update_physics_position_batch_avx2( double *position, double *speed, const double *acceleration, const double *gravity, double *angular_speed, const double *angular_acceleration, size_t nb, double dt, double half_dt2 )
+ *\brief AVX2 batch integrator, four componants per iteration
+ *\param position packed positions componants
+ *\param speed packed speeds componants
+ *\param acceleration packed accelerations componants
+ *\param gravity packed gravity componants
+ *\param angular_speed packed angular speeds componants
+ *\param angular_acceleration packed angular accelerations componants
+ *\param nb number of packed componants
+ *\param dt delta time in seconds
+ *\param half_dt2 dt * dt / 2
+ */
+__attribute__((target("avx2"))) static void update_physics_position_batch_avx2(double* position, double* speed, const double* acceleration, const double* gravity, double* angular_speed, const double* angular_acceleration, size_t nb, double dt, double half_dt2) {
+    __m256d vdt = _mm256_set1_pd(dt);
+    __m256d vhalf_dt2 = _mm256_set1_pd(half_dt2);
+    size_t it = 0;
+    for (; it + 4 <= nb; it += 4) {
+        __m256d acc = _mm256_loadu_pd(acceleration + it);
+        __m256d spd = _mm256_add_pd(_mm256_loadu_pd(speed + it), _mm256_mul_pd(acc, vdt));
+        __m256d pos = _mm256_add_pd(_mm256_add_pd(_mm256_loadu_pd(position + it), _mm256_mul_pd(spd, vdt)), _mm256_mul_pd(acc, vhalf_dt2));
+        __m256d ang = _mm256_add_pd(_mm256_loadu_pd(angular_speed + it), _mm256_mul_pd(_mm256_loadu_pd(angular_acceleration + it), vdt));
+        spd = _mm256_add_pd(spd, _mm256_mul_pd(_mm256_loadu_pd(gravity + it), vdt));
+        _mm256_storeu_pd(position + it, pos);
+        _mm256_storeu_pd(speed + it, spd);
+        _mm256_storeu_pd(angular_speed + it, ang);
+    }
+    update_physics_position_batch_scalar(position, speed, acceleration, gravity, angular_speed, angular_acceleration, it, nb, dt, half_dt2);
+} /* update_physics_position_batch_avx2(...) */
+#endif
+
+/*!\fn int get_physics_batch_path( void )
+ *\brief get the batch integrator path selected for the running cpu. The result is computed once and cached
+ *\return PHYSICS_BATCH_SCALAR, PHYSICS_BATCH_SSE2 or PHYSICS_BATCH_AVX2
+ */
+int get_physics_batch_path(void) {
+    static int path = -1;
+    if (path == -1) {
+        int detected = PHYSICS_BATCH_SCALAR;
+#ifdef N_3D_HAVE_X86_SIMD
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            detected = PHYSICS_BATCH_AVX2;
+        else if (__builtin_cpu_supports("sse2"))
+            detected = PHYSICS_BATCH_SSE2;
+#endif
+        path = detected;
+    }
+    return path;
+} /* get_physics_batch_path() */
+
+/*!\fn int update_physics_position_batch( double *position, double *speed, const double *acceleration, const double *gravity, double *angular_speed, const double *angular_acceleration, size_t nb, double delta_t )
+ *\brief Update nb packed componants in one fused pass. Same maths as update_physics_position_nb, applied to contiguous arrays (for example nb_objects VECTOR3D casted to double*, with nb = 3 * nb_objects)
+ *\param position packed positions componants
+ *\param speed packed speeds componants
+ *\param acceleration packed accelerations componants
+ *\param gravity packed gravity componants
+ *\param angular_speed packed angular speeds componants
+ *\param angular_acceleration packed angular accelerations componants
+ *\param nb number of packed componants
+ *\param delta_t Elapsed time since last call for componant update computing
+ *\return TRUE or FALSE
+ */
+int update_physics_position_batch(double* position, double* speed, const double* acceleration, const double* gravity, double* angular_speed, const double* angular_acceleration, size_t nb, double delta_t) {
+    __n_assert(position && speed && acceleration && gravity && angular_speed && angular_acceleration, return FALSE);
+
+    double dt = delta_t / 1000000.0;
+    double half_dt2 = (dt * dt) / 2.0;
+
+    switch (get_physics_batch_path()) {
+#ifdef N_3D_HAVE_X86_SIMD
+        case PHYSICS_BATCH_AVX2:
+            update_physics_position_batch_avx2(position, speed, acceleration, gravity, angular_speed, angular_acceleration, nb, dt, half_dt2);
+            break;
+        case PHYSICS_BATCH_SSE2:
+            update_physics_position_batch_sse2(position, speed, acceleration, gravity, angular_speed, angular_acceleration, nb, dt, half_dt2);
+            break;
+#endif
+        default:
+            update_physics_position_batch_scalar(position, speed, acceleration, gravity, angular_speed, angular_acceleration, 0, nb, dt, half_dt2);
+            break;
+    }
+    return TRUE;
+} /* update_physics_position_batch(...) */
+
 /*!\fn int same_sign( double a , double b )
  *\brief Quickly check if two walue are the same sign or not
  *\param a first value
@@ -25,7 +25,16 @@ int init_particle_system(PARTICLE_SYSTEM** psys, int max, double x, double y, do
 
     start_HiTimer(&(*psys)->timer);
 
-    (*psys)->list = new_generic_list(max);
+    (*psys)->nb_particles = 0;
+    (*psys)->nb_max_particles = max;
+    (*psys)->capacity = 0;
+
+    for (int it = 0; it < PARTICLE_WHEEL_BUCKETS; it++)
+        (*psys)->wheel_head[it] = -1;
+    (*psys)->wheel_tick = 0;
+    (*psys)->clock = 0.0;
+    (*psys)->interpolation = 1.0;
+    seed_particle_system((*psys), 0);
 
     (*psys)->source[0] = x;
     (*psys)->source[1] = y;
@@ -39,6 +48,239 @@ int init_particle_system(PARTICLE_SYSTEM** psys, int max, double x, double y, do
     return TRUE;
 } /* init_particle_system() */
 
+/*! initial number of slots allocated on the first add_particle */
+#define PARTICLE_SYSTEM_MIN_CAPACITY 1024
+
+/*!\fn int seed_particle_system( PARTICLE_SYSTEM *psys, uint64_t seed )
+ *\brief seed the random generator used by add_particles_batch, so that emissions are reproducible and independent from rand()
+ *\param psys targeted particle system
+ *\param seed seed value
+ *\return TRUE or FALSE
+ */
+int seed_particle_system(PARTICLE_SYSTEM* psys, uint64_t seed) {
+    __n_assert(psys, return FALSE);
+    // xorshift state must not be zero
+    psys->random_state = seed ^ 0x9E3779B97F4A7C15ULL;
+    if (psys->random_state == 0)
+        psys->random_state = 0x9E3779B97F4A7C15ULL;
+    return TRUE;
+} /* seed_particle_system() */
+
+/*!\fn int reserve_particles( PARTICLE_SYSTEM *psys, int capacity )
+ *\brief grow all the particle arrays so they can hold capacity particles without any further allocation
+ *\param psys targeted particle system
+ *\param capacity new number of slots
+ *\return TRUE or FALSE
+ */
+int reserve_particles(PARTICLE_SYSTEM* psys, int capacity) {
+    __n_assert(psys, return FALSE);
+
+    if (capacity <= psys->capacity)
+        return TRUE;
+
+#define __particle_array_grow(__field, __type)                                                     \
+    {                                                                                              \
+        __type* __new = (__type*)realloc(psys->__field, capacity * sizeof(__type));                \
+        if (!__new) {                                                                              \
+            n_log(LOG_ERR, "could not grow particle %s array to %d particles", #__field, capacity); \
+            return FALSE;                                                                          \
+        }                                                                                          \
+        psys->__field = __new;                                                                     \
+    }
+
+    __particle_array_grow(mode, int);
+    __particle_array_grow(lifetime, int);
+    __particle_array_grow(spr_id, int);
+    __particle_array_grow(size, int);
+    __particle_array_grow(color, ALLEGRO_COLOR);
+    __particle_array_grow(position, VECTOR3D);
+    __particle_array_grow(previous_position, VECTOR3D);
+    __particle_array_grow(speed, VECTOR3D);
+    __particle_array_grow(acceleration, VECTOR3D);
+    __particle_array_grow(gravity, VECTOR3D);
+    __particle_array_grow(orientation, VECTOR3D);
+    __particle_array_grow(angular_speed, VECTOR3D);
+    __particle_array_grow(angular_acceleration, VECTOR3D);
+    __particle_array_grow(wheel_expire, int64_t);
+    __particle_array_grow(wheel_bucket, int);
+    __particle_array_grow(wheel_next, int);
+    __particle_array_grow(wheel_prev, int);
+
+#undef __particle_array_grow
+
+    psys->capacity = capacity;
+
+    return TRUE;
+} /* reserve_particles() */
+
+/*!\fn static void particle_wheel_link( PARTICLE_SYSTEM *psys, int id )
+ *\brief Internal: put a particle in the timing wheel bucket matching its expiry tick. Lower level buckets have a finer resolution, upper levels are cascaded down when the wheel turns
+ *\param psys targeted particle system
+ *\param id particle index, with wheel_expire set
+ */
+static void particle_wheel_link(PARTICLE_SYSTEM* psys, int id) {
+    int64_t expire = psys->wheel_expire[id];
+    int64_t delta = expire - psys->wheel_tick;
+    int bucket = 0;
+
+    if (delta <= 0) {
+        // already expired: retired on the next tick
+        expire = psys->wheel_tick + 1;
+        delta = 1;
+    }
+
+    if (delta < (1 << PARTICLE_WHEEL_L0_BITS)) {
+        bucket = expire & ((1 << PARTICLE_WHEEL_L0_BITS) - 1);
+    } else {
+        int level = 0;
+        int shift = PARTICLE_WHEEL_L0_BITS;
+        while (level < PARTICLE_WHEEL_UPPER_LEVELS - 1 && delta >= ((int64_t)1 << (shift + PARTICLE_WHEEL_LN_BITS))) {
+            level++;
+            shift += PARTICLE_WHEEL_LN_BITS;
+        }
+        int64_t max_delta = ((int64_t)1 << (shift + PARTICLE_WHEEL_LN_BITS)) - 1;
+        if (delta > max_delta) {
+            // out of range: parked in the farthest bucket and cascaded again later
+            expire = psys->wheel_tick + max_delta;
+        }
+        bucket = (1 << PARTICLE_WHEEL_L0_BITS) + level * (1 << PARTICLE_WHEEL_LN_BITS) + ((expire >> shift) & ((1 << PARTICLE_WHEEL_LN_BITS) - 1));
+    }
+
+    psys->wheel_bucket[id] = bucket;
+    psys->wheel_prev[id] = -1;
+    psys->wheel_next[id] = psys->wheel_head[bucket];
+    if (psys->wheel_head[bucket] != -1)
+        psys->wheel_prev[psys->wheel_head[bucket]] = id;
+    psys->wheel_head[bucket] = id;
+} /* particle_wheel_link() */
+
+/*!\fn static void particle_wheel_unlink( PARTICLE_SYSTEM *psys, int id )
+ *\brief Internal: remove a particle from its timing wheel bucket
+ *\param psys targeted particle system
+ *\param id particle index
+ */
+static void particle_wheel_unlink(PARTICLE_SYSTEM* psys, int id) {
+    int bucket = psys->wheel_bucket[id];
+    if (bucket == -1)
+        return;
+
+    if (psys->wheel_prev[id] != -1)
+        psys->wheel_next[psys->wheel_prev[id]] = psys->wheel_next[id];
+    else
+        psys->wheel_head[bucket] = psys->wheel_next[id];
+    if (psys->wheel_next[id] != -1)
+        psys->wheel_prev[psys->wheel_next[id]] = psys->wheel_prev[id];
+
+    psys->wheel_bucket[id] = -1;
+} /* particle_wheel_unlink() */
+
+/*!\fn static void particle_wheel_schedule( PARTICLE_SYSTEM *psys, int id, int lifetime )
+ *\brief Internal: schedule the expiry of a new particle, if it is not immortal
+ *\param psys targeted particle system
+ *\param id particle index
+ *\param lifetime particle lifetime, -1 for immortal
+ */
+static void particle_wheel_schedule(PARTICLE_SYSTEM* psys, int id, int lifetime) {
+    psys->wheel_bucket[id] = -1;
+    if (lifetime == -1)
+        return;
+    psys->wheel_expire[id] = (int64_t)ceil((psys->clock + lifetime) / PARTICLE_WHEEL_GRANULARITY);
+    particle_wheel_link(psys, id);
+} /* particle_wheel_schedule() */
+
+/*!\fn static void particle_wheel_cascade( PARTICLE_SYSTEM *psys, int bucket )
+ *\brief Internal: move all the particles of an upper level bucket to the buckets matching their expiry tick
+ *\param psys targeted particle system
+ *\param bucket bucket to cascade
+ */
+static void particle_wheel_cascade(PARTICLE_SYSTEM* psys, int bucket) {
+    int id = psys->wheel_head[bucket];
+    psys->wheel_head[bucket] = -1;
+    while (id != -1) {
+        int next = psys->wheel_next[id];
+        particle_wheel_link(psys, id);
+        id = next;
+    }
+} /* particle_wheel_cascade() */
+
+/*!\fn int remove_particle( PARTICLE_SYSTEM *psys, int index )
+ *\brief remove a particle by moving the last particle of the arrays into its slot
+ *\param psys targeted particle system
+ *\param index index of the particle to remove
+ *\return TRUE or FALSE
+ */
+int remove_particle(PARTICLE_SYSTEM* psys, int index) {
+    __n_assert(psys, return FALSE);
+    __n_assert(index >= 0 && index < psys->nb_particles, return FALSE);
+
+    particle_wheel_unlink(psys, index);
+
+    int last = psys->nb_particles - 1;
+    if (index != last) {
+        psys->mode[index] = psys->mode[last];
+        psys->lifetime[index] = psys->lifetime[last];
+        psys->spr_id[index] = psys->spr_id[last];
+        psys->size[index] = psys->size[last];
+        psys->color[index] = psys->color[last];
+        copy_point(psys->position[last], psys->position[index]);
+        copy_point(psys->previous_position[last], psys->previous_position[index]);
+        copy_point(psys->speed[last], psys->speed[index]);
+        copy_point(psys->acceleration[last], psys->acceleration[index]);
+        copy_point(psys->gravity[last], psys->gravity[index]);
+        copy_point(psys->orientation[last], psys->orientation[index]);
+        copy_point(psys->angular_speed[last], psys->angular_speed[index]);
+        copy_point(psys->angular_acceleration[last], psys->angular_acceleration[index]);
+
+        // relink the moved particle neighbours to its new slot
+        int bucket = psys->wheel_bucket[last];
+        psys->wheel_expire[index] = psys->wheel_expire[last];
+        psys->wheel_bucket[index] = bucket;
+        psys->wheel_next[index] = psys->wheel_next[last];
+        psys->wheel_prev[index] = psys->wheel_prev[last];
+        if (bucket != -1) {
+            if (psys->wheel_prev[index] != -1)
+                psys->wheel_next[psys->wheel_prev[index]] = index;
+            else
+                psys->wheel_head[bucket] = index;
+            if (psys->wheel_next[index] != -1)
+                psys->wheel_prev[psys->wheel_next[index]] = index;
+        }
+    }
+    psys->nb_particles--;
+
+    return TRUE;
+} /* remove_particle() */
+
+/*!\fn static void particle_wheel_advance( PARTICLE_SYSTEM *psys, double delta_t )
+ *\brief Internal: move the clock forward, turning the wheel and removing the particles of each expired bucket
+ *\param psys targeted particle system
+ *\param delta_t elapsed time, in lifetime units
+ */
+static void particle_wheel_advance(PARTICLE_SYSTEM* psys, double delta_t) {
+    psys->clock += delta_t;
+    int64_t target = (int64_t)floor(psys->clock / PARTICLE_WHEEL_GRANULARITY);
+
+    while (psys->wheel_tick < target) {
+        psys->wheel_tick++;
+        int64_t tick = psys->wheel_tick;
+
+        int shift = PARTICLE_WHEEL_L0_BITS;
+        int64_t mask = (1 << PARTICLE_WHEEL_L0_BITS) - 1;
+        for (int level = 0; level < PARTICLE_WHEEL_UPPER_LEVELS && (tick & mask) == 0; level++) {
+            int slot = (tick >> shift) & ((1 << PARTICLE_WHEEL_LN_BITS) - 1);
+            particle_wheel_cascade(psys, (1 << PARTICLE_WHEEL_L0_BITS) + level * (1 << PARTICLE_WHEEL_LN_BITS) + slot);
+            shift += PARTICLE_WHEEL_LN_BITS;
+            mask = ((int64_t)1 << shift) - 1;
+        }
+
+        int bucket = tick & ((1 << PARTICLE_WHEEL_L0_BITS) - 1);
+        // removal unlinks the head, and relinks the particle moved in its slot
+        while (psys->wheel_head[bucket] != -1) {
+            remove_particle(psys, psys->wheel_head[bucket]);
+        }
+    }
+} /* particle_wheel_advance() */
+
 /*!\fn int add_particle( PARTICLE_SYSTEM *psys, int spr, int mode, int lifetime, int size, ALLEGRO_COLOR color, PHYSICS object )
  *\brief add a particle to a particle system
  *\param psys targeted particle system
@@ -51,31 +293,143 @@ int init_particle_system(PARTICLE_SYSTEM** psys, int max, double x, double y, do
  *\return TRUE or FALSE
  */
 int add_particle(PARTICLE_SYSTEM* psys, int spr, int mode, int lifetime, int size, ALLEGRO_COLOR color, PHYSICS object) {
-    int it = 0;
-
-    PARTICLE* new_p = NULL;
+    __n_assert(psys, return FALSE);
 
-    if (psys->list->nb_items == psys->list->nb_max_items)
+    if (psys->nb_max_particles > 0 && psys->nb_particles >= psys->nb_max_particles)
         return FALSE;
 
-    for (it = 0; it < 3; it++) {
-        object.position[it] += psys->source[it];
+    if (psys->nb_particles == psys->capacity) {
+        int new_capacity = (psys->capacity > 0) ? psys->capacity * 2 : PARTICLE_SYSTEM_MIN_CAPACITY;
+        if (psys->nb_max_particles > 0 && new_capacity > psys->nb_max_particles)
+            new_capacity = psys->nb_max_particles;
+        if (reserve_particles(psys, new_capacity) != TRUE)
+            return FALSE;
     }
 
-    Malloc(new_p, PARTICLE, 1);
-    __n_assert(new_p, return FALSE);
+    int id = psys->nb_particles;
 
-    new_p->spr_id = spr;
-    new_p->mode = mode;
-    new_p->lifetime = lifetime;
-    new_p->color = color;
-    new_p->size = size;
+    psys->spr_id[id] = spr;
+    psys->mode[id] = mode;
+    psys->lifetime[id] = lifetime;
+    psys->color[id] = color;
+    psys->size[id] = size;
 
-    memcpy(&new_p->object, &object, sizeof(PHYSICS));
+    for (int it = 0; it < 3; it++) {
+        psys->position[id][it] = object.position[it] + psys->source[it];
+        psys->previous_position[id][it] = psys->position[id][it];
+        psys->speed[id][it] = object.speed[it];
+        psys->acceleration[id][it] = object.acceleration[it];
+        psys->gravity[id][it] = object.gravity[it];
+        psys->orientation[id][it] = object.orientation[it];
+        psys->angular_speed[id][it] = object.angular_speed[it];
+        psys->angular_acceleration[id][it] = object.angular_acceleration[it];
+    }
+    particle_wheel_schedule(psys, id, lifetime);
+
+    psys->nb_particles++;
 
-    return list_push(psys->list, new_p, &free);
+    return TRUE;
 } /* add_particle() */
 
+/*!\fn static uint32_t particle_rand( PARTICLE_SYSTEM *psys )
+ *\brief Internal: next value of the particle system xorshift64* generator
+ *\param psys targeted particle system
+ *\return a 32 bits random value
+ */
+static uint32_t particle_rand(PARTICLE_SYSTEM* psys) {
+    psys->random_state ^= psys->random_state >> 12;
+    psys->random_state ^= psys->random_state << 25;
+    psys->random_state ^= psys->random_state >> 27;
+    return (uint32_t)((psys->random_state * 0x2545F4914F6CDD1DULL) >> 32);
+} /* particle_rand() */
+
+/*!\fn static double particle_random( PARTICLE_SYSTEM *psys, double range )
+ *\brief random value between 0 and range
+ *\param psys particle system holding the generator
+ *\param range upper bound
+ *\return a random value in [ 0, range ]
+ */
+static double particle_random(PARTICLE_SYSTEM* psys, double range) {
+    if (range == 0.0)
+        return 0.0;
+    return range * ((double)particle_rand(psys) / (double)UINT32_MAX);
+} /* particle_random() */
+
+/*!\fn static float particle_random_channel( PARTICLE_SYSTEM *psys, float base, float range )
+ *\brief random color channel value clamped to [ 0, 1 ]
+ *\param psys particle system holding the generator
+ *\param base base value of the channel
+ *\param range random range added to base
+ *\return the channel value
+ */
+static float particle_random_channel(PARTICLE_SYSTEM* psys, float base, float range) {
+    float value = base + (float)particle_random(psys, range);
+    if (value < 0.0f) value = 0.0f;
+    if (value > 1.0f) value = 1.0f;
+    return value;
+} /* particle_random_channel() */
+
+/*!\fn int add_particles_batch( PARTICLE_SYSTEM *psys, int count, const PARTICLE_EMITTER *emitter )
+ *\brief add a burst of particles to a particle system in one pass. Storage is grown at most once, and not at all if reserve_particles was called with enough room
+ *\param psys targeted particle system
+ *\param count number of particles to add
+ *\param emitter description of the burst: base values and random ranges
+ *\return the number of added particles, which can be lower than count if the system is full
+ */
+int add_particles_batch(PARTICLE_SYSTEM* psys, int count, const PARTICLE_EMITTER* emitter) {
+    __n_assert(psys, return 0);
+    __n_assert(emitter, return 0);
+
+    if (count <= 0)
+        return 0;
+
+    if (psys->nb_max_particles > 0 && psys->nb_particles + count > psys->nb_max_particles)
+        count = psys->nb_max_particles - psys->nb_particles;
+    if (count <= 0)
+        return 0;
+
+    if (psys->nb_particles + count > psys->capacity) {
+        int new_capacity = (psys->capacity > 0) ? psys->capacity : PARTICLE_SYSTEM_MIN_CAPACITY;
+        while (new_capacity < psys->nb_particles + count)
+            new_capacity *= 2;
+        if (psys->nb_max_particles > 0 && new_capacity > psys->nb_max_particles)
+            new_capacity = psys->nb_max_particles;
+        if (reserve_particles(psys, new_capacity) != TRUE)
+            return 0;
+    }
+
+    const PHYSICS* object = &emitter->object;
+    int start = psys->nb_particles;
+    int end = start + count;
+
+    for (int id = start; id < end; id++) {
+        psys->spr_id[id] = emitter->spr_id;
+        psys->mode[id] = emitter->mode;
+        psys->lifetime[id] = emitter->lifetime + ((emitter->lifetime_range > 0) ? particle_rand(psys) % (emitter->lifetime_range + 1) : 0);
+        psys->size[id] = emitter->size + ((emitter->size_range > 0) ? particle_rand(psys) % (emitter->size_range + 1) : 0);
+
+        psys->color[id].r = particle_random_channel(psys, emitter->color.r, emitter->color_range.r);
+        psys->color[id].g = particle_random_channel(psys, emitter->color.g, emitter->color_range.g);
+        psys->color[id].b = particle_random_channel(psys, emitter->color.b, emitter->color_range.b);
+        psys->color[id].a = particle_random_channel(psys, emitter->color.a, emitter->color_range.a);
+
+        for (int it = 0; it < 3; it++) {
+            psys->position[id][it] = object->position[it] + particle_random(psys, emitter->position_range[it]) + psys->source[it];
+            psys->previous_position[id][it] = psys->position[id][it];
+            psys->speed[id][it] = object->speed[it] + particle_random(psys, emitter->speed_range[it]);
+            psys->acceleration[id][it] = object->acceleration[it];
+            psys->gravity[id][it] = object->gravity[it];
+            psys->orientation[id][it] = object->orientation[it];
+            psys->angular_speed[id][it] = object->angular_speed[it];
+            psys->angular_acceleration[id][it] = object->angular_acceleration[it];
+        }
+        particle_wheel_schedule(psys, id, psys->lifetime[id]);
+    }
+    psys->nb_particles = end;
+
+    return count;
+} /* add_particles_batch() */
+
 /*!\fn int add_particle_ex( PARTICLE_SYSTEM *psys, int spr, int mode, int off_x, int off_y, int lifetime, int size, ALLEGRO_COLOR color, double vx, double vy, double vz, double ax, double ay, double az )
  *\brief add a particle to a particle system, all in line version (you have to set the PHYSICS object parameter in the function parameter instead of providing a PHYSICS object)
  *\param psys targeted particle system
@@ -96,6 +450,7 @@ int add_particle(PARTICLE_SYSTEM* psys, int spr, int mode, int lifetime, int siz
  */
 int add_particle_ex(PARTICLE_SYSTEM* psys, int spr, int mode, int off_x, int off_y, int lifetime, int size, ALLEGRO_COLOR color, double vx, double vy, double vz, double ax, double ay, double az) {
     PHYSICS object;
+    memset(&object, 0, sizeof(PHYSICS));
     VECTOR3D_SET(object.position, off_x, off_y, 0.0);
     VECTOR3D_SET(object.speed, vx, vy, vz);
     VECTOR3D_SET(object.acceleration, ax, ay, az);
@@ -115,30 +470,121 @@ int add_particle_ex(PARTICLE_SYSTEM* psys, int spr, int mode, int off_x, int off
 int manage_particle_ex(PARTICLE_SYSTEM* psys, double delta_t) {
     __n_assert(psys, return FALSE);
 
-    LIST_NODE* node = NULL;
-    PARTICLE* ptr = NULL;
+    // retire the expired particles bucket by bucket, live ones are not visited
+    particle_wheel_advance(psys, delta_t / 1000.0);
+
+    // integration pass over the survivors
+    if (psys->nb_particles > 0) {
+        memcpy(psys->previous_position, psys->position, psys->nb_particles * sizeof(VECTOR3D));
+        update_physics_position_batch((double*)psys->position, (double*)psys->speed, (const double*)psys->acceleration, (const double*)psys->gravity, (double*)psys->angular_speed, (const double*)psys->angular_acceleration, 3 * (size_t)psys->nb_particles, delta_t);
+    }
+
+    return TRUE;
+} /* manage_particle_ex() */
+
+/*! Internal: a range of particles updated by manage_particle_threaded */
+typedef struct PARTICLE_THREAD_JOB {
+    /*! targeted particle system */
+    PARTICLE_SYSTEM* psys;
+    /*! first particle of the range */
+    int start;
+    /*! end of the range, excluded */
+    int end;
+    /*! delta time to use */
+    double delta_t;
+    /*! shared number of unfinished jobs */
+    int* nb_running;
+    /*! lock on nb_running */
+    pthread_mutex_t* lock;
+    /*! signaled when nb_running reaches zero */
+    pthread_cond_t* done;
+} PARTICLE_THREAD_JOB;
+
+/*!\fn static void* manage_particle_range( void *param )
+ *\brief Internal: update positions of a PARTICLE_THREAD_JOB range
+ *\param param a PARTICLE_THREAD_JOB
+ *\return NULL
+ */
+static void* manage_particle_range(void* param) {
+    PARTICLE_THREAD_JOB* job = (PARTICLE_THREAD_JOB*)param;
+    PARTICLE_SYSTEM* psys = job->psys;
+
+    memcpy(psys->previous_position[job->start], psys->position[job->start], (job->end - job->start) * sizeof(VECTOR3D));
+    update_physics_position_batch((double*)psys->position[job->start], (double*)psys->speed[job->start], (const double*)psys->acceleration[job->start], (const double*)psys->gravity[job->start], (double*)psys->angular_speed[job->start], (const double*)psys->angular_acceleration[job->start], 3 * (size_t)(job->end - job->start), job->delta_t);
+
+    pthread_mutex_lock(job->lock);
+    (*job->nb_running)--;
+    if ((*job->nb_running) == 0)
+        pthread_cond_signal(job->done);
+    pthread_mutex_unlock(job->lock);
+
+    return NULL;
+} /* manage_particle_range() */
+
+/*!\fn int manage_particle_threaded( PARTICLE_SYSTEM *psys, THREAD_POOL *thread_pool, double delta_t )
+ *\brief update particles positions using provided delta time. Expired particles are retired first, then the survivors are split in ranges processed by the thread pool. Falls back to manage_particle_ex when there is not enough particles to share
+ *\param psys the targeted particle system
+ *\param thread_pool the thread pool to use
+ *\param delta_t delta time to use, in msecs
+ *\return TRUE or FALSE
+ */
+int manage_particle_threaded(PARTICLE_SYSTEM* psys, THREAD_POOL* thread_pool, double delta_t) {
+    __n_assert(psys, return FALSE);
+
+    if (!thread_pool)
+        return manage_particle_ex(psys, delta_t);
 
-    node = psys->list->start;
+    int nb_jobs = psys->nb_particles / PARTICLE_MIN_THREAD_RANGE;
+    if (nb_jobs > thread_pool->max_threads)
+        nb_jobs = thread_pool->max_threads;
+    if (nb_jobs > PARTICLE_MAX_THREAD_JOBS)
+        nb_jobs = PARTICLE_MAX_THREAD_JOBS;
+    if (nb_jobs < 2)
+        return manage_particle_ex(psys, delta_t);
 
-    while (node) {
-        ptr = (PARTICLE*)node->ptr;
-        if (ptr->lifetime != -1) {
-            ptr->lifetime -= delta_t / 1000.0;
+    particle_wheel_advance(psys, delta_t / 1000.0);
+    if (psys->nb_particles < nb_jobs * PARTICLE_MIN_THREAD_RANGE / 2) {
+        // most of the particles expired: not worth sharing
+        if (psys->nb_particles > 0) {
+            memcpy(psys->previous_position, psys->position, psys->nb_particles * sizeof(VECTOR3D));
+            update_physics_position_batch((double*)psys->position, (double*)psys->speed, (const double*)psys->acceleration, (const double*)psys->gravity, (double*)psys->angular_speed, (const double*)psys->angular_acceleration, 3 * (size_t)psys->nb_particles, delta_t);
         }
+        return TRUE;
+    }
 
-        if (ptr->lifetime > 0 || ptr->lifetime == -1) {
-            update_physics_position(&ptr->object, delta_t);
-            node = node->next;
-        } else {
-            LIST_NODE* node_to_kill = node;
-            node = node->next;
-            ptr = remove_list_node(psys->list, node_to_kill, PARTICLE);
-            Free(ptr);
+    PARTICLE_THREAD_JOB jobs[PARTICLE_MAX_THREAD_JOBS];
+    pthread_mutex_t lock;
+    pthread_cond_t done;
+    int nb_running = nb_jobs;
+
+    pthread_mutex_init(&lock, NULL);
+    pthread_cond_init(&done, NULL);
+
+    int range = psys->nb_particles / nb_jobs;
+    for (int it = 0; it < nb_jobs; it++) {
+        jobs[it].psys = psys;
+        jobs[it].start = it * range;
+        jobs[it].end = (it == nb_jobs - 1) ? psys->nb_particles : (it + 1) * range;
+        jobs[it].delta_t = delta_t;
+        jobs[it].nb_running = &nb_running;
+        jobs[it].lock = &lock;
+        jobs[it].done = &done;
+        if (add_threaded_process(thread_pool, &manage_particle_range, &jobs[it], DIRECT_PROC) == FALSE) {
+            n_log(LOG_DEBUG, "particle range %d-%d processed in caller thread", jobs[it].start, jobs[it].end);
+            manage_particle_range(&jobs[it]);
         }
     }
 
+    pthread_mutex_lock(&lock);
+    while (nb_running > 0)
+        pthread_cond_wait(&done, &lock);
+    pthread_mutex_unlock(&lock);
+
+    pthread_cond_destroy(&done);
+    pthread_mutex_destroy(&lock);
+
     return TRUE;
-} /* manage_particle_ex() */
+} /* manage_particle_threaded() */
 
 /*!\fn int manage_particle( PARTICLE_SYSTEM *psys )
  *\brief update particles positions usting particle system internal timer
@@ -148,12 +594,114 @@ int manage_particle_ex(PARTICLE_SYSTEM* psys, double delta_t) {
 int manage_particle(PARTICLE_SYSTEM* psys) {
     __n_assert(psys, return FALSE);
 
-    double delta_t = get_usec(&psys->timer);
+    // sub-usec precision, in the usecs manage_particle_ex expects
+    double delta_t = get_nsec(&psys->timer) / 1000.0;
     return manage_particle_ex(psys, delta_t);
 } /* manage_particle() */
 
+/*!\fn int set_particle_interpolation( PARTICLE_SYSTEM *psys, double alpha )
+ *\brief set how far between the last two updates draw_particle places the particles, for a display running at a different rate than the updates
+ *\param psys targeted particle system
+ *\param alpha 0.0 for the positions before the last update, 1.0 for the current ones. Clamped to [ 0.0, 1.0 ]
+ *\return TRUE or FALSE
+ */
+int set_particle_interpolation(PARTICLE_SYSTEM* psys, double alpha) {
+    __n_assert(psys, return FALSE);
+
+    if (alpha < 0.0)
+        alpha = 0.0;
+    if (alpha > 1.0)
+        alpha = 1.0;
+    psys->interpolation = alpha;
+
+    return TRUE;
+} /* set_particle_interpolation() */
+
+/*!\fn static int particle_quads_reserve( PARTICLE_SYSTEM *psys, int nb_quads )
+ *\brief Internal: grow the quad vertex and index buffers, filling the new part of the index buffer
+ *\param psys targeted particle system
+ *\param nb_quads number of quads to hold
+ *\return TRUE or FALSE
+ */
+static int particle_quads_reserve(PARTICLE_SYSTEM* psys, int nb_quads) {
+    if (nb_quads <= psys->quad_capacity)
+        return TRUE;
+
+    int capacity = (psys->quad_capacity > 0) ? psys->quad_capacity : PARTICLE_SYSTEM_MIN_CAPACITY;
+    while (capacity < nb_quads)
+        capacity *= 2;
+
+    ALLEGRO_VERTEX* vertices = (ALLEGRO_VERTEX*)realloc(psys->quad_vertices, 4 * capacity * sizeof(ALLEGRO_VERTEX));
+    if (!vertices) {
+        n_log(LOG_ERR, "could not grow particle quad vertices to %d quads", capacity);
+        return FALSE;
+    }
+    psys->quad_vertices = vertices;
+
+    int* indices = (int*)realloc(psys->quad_indices, 6 * capacity * sizeof(int));
+    if (!indices) {
+        n_log(LOG_ERR, "could not grow particle quad indices to %d quads", capacity);
+        return FALSE;
+    }
+    psys->quad_indices = indices;
+
+    for (int it = psys->quad_capacity; it < capacity; it++) {
+        int* idx = psys->quad_indices + 6 * it;
+        idx[0] = 4 * it;
+        idx[1] = 4 * it + 1;
+        idx[2] = 4 * it + 2;
+        idx[3] = 4 * it;
+        idx[4] = 4 * it + 2;
+        idx[5] = 4 * it + 3;
+    }
+    psys->quad_capacity = capacity;
+
+    return TRUE;
+} /* particle_quads_reserve() */
+
+/*!\fn static int particle_circles_reserve( PARTICLE_SYSTEM *psys, int nb_circles )
+ *\brief Internal: grow the circle vertex buffer
+ *\param psys targeted particle system
+ *\param nb_circles number of circles to hold
+ *\return TRUE or FALSE
+ */
+static int particle_circles_reserve(PARTICLE_SYSTEM* psys, int nb_circles) {
+    if (nb_circles <= psys->circle_capacity)
+        return TRUE;
+
+    int capacity = (psys->circle_capacity > 0) ? psys->circle_capacity : PARTICLE_SYSTEM_MIN_CAPACITY;
+    while (capacity < nb_circles)
+        capacity *= 2;
+
+    ALLEGRO_VERTEX* vertices = (ALLEGRO_VERTEX*)realloc(psys->circle_vertices, 6 * PARTICLE_CIRCLE_SEGMENTS * capacity * sizeof(ALLEGRO_VERTEX));
+    if (!vertices) {
+        n_log(LOG_ERR, "could not grow particle circle vertices to %d circles", capacity);
+        return FALSE;
+    }
+    psys->circle_vertices = vertices;
+    psys->circle_capacity = capacity;
+
+    return TRUE;
+} /* particle_circles_reserve() */
+
+/*!\fn static inline void particle_set_vertex( ALLEGRO_VERTEX *vertex, double x, double y, ALLEGRO_COLOR color )
+ *\brief Internal: fill an untextured vertex
+ *\param vertex vertex to fill
+ *\param x x position
+ *\param y y position
+ *\param color vertex color
+ */
+static inline void particle_set_vertex(ALLEGRO_VERTEX* vertex, double x, double y, ALLEGRO_COLOR color) {
+    vertex->x = x;
+    vertex->y = y;
+    vertex->z = 0;
+    vertex->u = 0;
+    vertex->v = 0;
+    vertex->color = color;
+}
+
 /*!\fn int draw_particle( PARTICLE_SYSTEM *psys, double xpos, double ypos, int w, int h, double range )
- *\brief draw particles of a particle system
+ *\brief draw particles of a particle system. Pixel particles are written as quads and circle particles as one pixel wide rings into vertex buffers, each buffer being sent in a single primitive call. Sprite particles are drawn with held bitmap drawing.
  *\param psys the targeted particle system
  *\param xpos camera x position
  *\param ypos camera y position
@@ -165,69 +713,173 @@ int manage_particle(PARTICLE_SYSTEM* psys) {
 int draw_particle(PARTICLE_SYSTEM* psys, double xpos, double ypos, int w, int h, double range) {
     __n_assert(psys, return FALSE);
 
-    LIST_NODE* node = NULL;
-    PARTICLE* ptr = NULL;
+    static double circle_cos[PARTICLE_CIRCLE_SEGMENTS + 1];
+    static double circle_sin[PARTICLE_CIRCLE_SEGMENTS + 1];
+    static bool circle_table_done = false;
+    if (!circle_table_done) {
+        for (int it = 0; it <= PARTICLE_CIRCLE_SEGMENTS; it++) {
+            circle_cos[it] = cos((2.0 * M_PI * it) / PARTICLE_CIRCLE_SEGMENTS);
+            circle_sin[it] = sin((2.0 * M_PI * it) / PARTICLE_CIRCLE_SEGMENTS);
+        }
+        circle_table_done = true;
+    }
 
-    node = psys->list->start;
+    int nb_quads = 0;
+    int nb_circles = 0;
+    bool held = al_is_bitmap_drawing_held();
+    double alpha = psys->interpolation;
 
-    while (node) {
+    for (int id = 0; id < psys->nb_particles; id++) {
         double x = 0, y = 0;
 
-        ptr = (PARTICLE*)node->ptr;
-        x = ptr->object.position[0] - xpos;
-        y = ptr->object.position[1] - ypos;
+        double* position = psys->position[id];
+        double* previous_position = psys->previous_position[id];
+        double* speed = psys->speed[id];
+        double* orientation = psys->orientation[id];
+        int spr_id = psys->spr_id[id];
+        int mode = psys->mode[id];
+
+        // world position blended between the last two updates
+        double px = previous_position[0] + (position[0] - previous_position[0]) * alpha;
+        double py = previous_position[1] + (position[1] - previous_position[1]) * alpha;
+
+        x = px - xpos;
+        y = py - ypos;
 
         if ((x < -range) || (x > (w + range)) || (y < -range) || (y > (h + range))) {
-            node = node->next;
             continue;
         }
 
         for (int it = 0; it < 3; it++) {
-            while (ptr->object.orientation[it] < 0.0)
-                ptr->object.orientation[it] += 256.0;
+            while (orientation[it] < 0.0)
+                orientation[it] += 256.0;
 
-            if (ptr->object.orientation[it] >= 256.0)
-                ptr->object.orientation[it] = fmod(ptr->object.orientation[it], 256.0);
+            if (orientation[it] >= 256.0)
+                orientation[it] = fmod(orientation[it], 256.0);
         }
 
-        if (ptr->mode == SINUS_PART) {
-            if (ptr->object.speed[0] != 0)
-                x = x + ptr->object.speed[0] * sin((ptr->object.position[0] / ptr->object.speed[0]));
+        bool has_sprite = (spr_id >= 0 && spr_id < psys->max_sprites && psys->sprites[spr_id]);
+        int nb_rings = 0;
+
+        if (mode == SINUS_PART) {
+            if (speed[0] != 0)
+                x = x + speed[0] * sin((px / speed[0]));
             else
-                x = x + ptr->object.speed[0] * sin(ptr->object.position[0]);
+                x = x + speed[0] * sin(px);
 
-            if (ptr->object.speed[1] != 0)
-                y = y + ptr->object.speed[1] * cos((ptr->object.speed[1] / ptr->object.speed[1]));
+            if (speed[1] != 0)
+                y = y + speed[1] * cos((speed[1] / speed[1]));
             else
-                y = y + ptr->object.speed[1] * sin(ptr->object.position[1]);
+                y = y + speed[1] * sin(py);
 
-            if (ptr->spr_id >= 0 && ptr->spr_id < psys->max_sprites && psys->sprites[ptr->spr_id]) {
-                int spr_w = al_get_bitmap_width(psys->sprites[ptr->spr_id]);
-                int spr_h = al_get_bitmap_height(psys->sprites[ptr->spr_id]);
+            if (!has_sprite)
+                nb_rings++;
+        }
 
-                al_draw_rotated_bitmap(psys->sprites[ptr->spr_id], spr_w / 2, spr_h / 2, x - spr_w / 2, y - spr_h / 2, al_ftofix(ptr->object.orientation[2]), 0);
-            } else
-                al_draw_circle(x, y, ptr->size, ptr->color, 1);
+        if (has_sprite && (mode == SINUS_PART || (mode & NORMAL_PART))) {
+            if (!al_is_bitmap_drawing_held())
+                al_hold_bitmap_drawing(true);
+            int spr_w = al_get_bitmap_width(psys->sprites[spr_id]);
+            int spr_h = al_get_bitmap_height(psys->sprites[spr_id]);
+            al_draw_rotated_bitmap(psys->sprites[spr_id], spr_w / 2, spr_h / 2, x - spr_w / 2, y - spr_h / 2, al_ftofix(orientation[2]), 0);
         }
 
-        if (ptr->mode & NORMAL_PART) {
-            if (ptr->spr_id >= 0 && ptr->spr_id < psys->max_sprites && psys->sprites[ptr->spr_id]) {
-                int w = al_get_bitmap_width(psys->sprites[ptr->spr_id]);
-                int h = al_get_bitmap_height(psys->sprites[ptr->spr_id]);
+        double size = psys->size[id];
+        ALLEGRO_COLOR color = psys->color[id];
 
-                al_draw_rotated_bitmap(psys->sprites[ptr->spr_id], w / 2, h / 2, x - w / 2, y - h / 2, al_ftofix(ptr->object.orientation[2]), 0);
-            } else
-                al_draw_circle(x, y, ptr->size, ptr->color, 1);
-        } else if (ptr->mode & PIXEL_PART) {
-            al_draw_filled_rectangle(x - ptr->size, y - ptr->size, x + ptr->size, y + ptr->size, ptr->color);
+        if (mode & NORMAL_PART) {
+            if (!has_sprite)
+                nb_rings++;
+        } else if (mode & PIXEL_PART) {
+            if (particle_quads_reserve(psys, nb_quads + 1) == TRUE) {
+                ALLEGRO_VERTEX* quad = psys->quad_vertices + 4 * nb_quads;
+                particle_set_vertex(&quad[0], x - size, y - size, color);
+                particle_set_vertex(&quad[1], x + size, y - size, color);
+                particle_set_vertex(&quad[2], x + size, y + size, color);
+                particle_set_vertex(&quad[3], x - size, y + size, color);
+                nb_quads++;
+            }
         } else
-            al_draw_circle(x, y, ptr->size, ptr->color, 1);
-        node = node->next;
+            nb_rings++;
+
+        for (int ring = 0; ring < nb_rings; ring++) {
+            if (particle_circles_reserve(psys, nb_circles + 1) != TRUE)
+                break;
+            ALLEGRO_VERTEX* vertex = psys->circle_vertices + 6 * PARTICLE_CIRCLE_SEGMENTS * nb_circles;
+            double outer = size + 0.5;
+            double inner = size - 0.5;
+            for (int it = 0; it < PARTICLE_CIRCLE_SEGMENTS; it++) {
+                double ox0 = x + outer * circle_cos[it], oy0 = y + outer * circle_sin[it];
+                double ox1 = x + outer * circle_cos[it + 1], oy1 = y + outer * circle_sin[it + 1];
+                double ix0 = x + inner * circle_cos[it], iy0 = y + inner * circle_sin[it];
+                double ix1 = x + inner * circle_cos[it + 1], iy1 = y + inner * circle_sin[it + 1];
+                particle_set_vertex(vertex++, ox0, oy0, color);
+                particle_set_vertex(vertex++, ox1, oy1, color);
+                particle_set_vertex(vertex++, ix1, iy1, color);
+                particle_set_vertex(vertex++, ox0, oy0, color);
+                particle_set_vertex(vertex++, ix1, iy1, color);
+                particle_set_vertex(vertex++, ix0, iy0, color);
+            }
+            nb_circles++;
+        }
     }
 
+    if (!held && al_is_bitmap_drawing_held())
+        al_hold_bitmap_drawing(false);
+
+    if (nb_quads > 0)
+        al_draw_indexed_prim(psys->quad_vertices, NULL, NULL, psys->quad_indices, 6 * nb_quads, ALLEGRO_PRIM_TRIANGLE_LIST);
+    if (nb_circles > 0)
+        al_draw_prim(psys->circle_vertices, NULL, NULL, 0, 6 * PARTICLE_CIRCLE_SEGMENTS * nb_circles, ALLEGRO_PRIM_TRIANGLE_LIST);
+
     return TRUE;
 } /* draw_particle() */
 
+/*!\fn int copy_visible_particles( PARTICLE_SYSTEM *dst, const PARTICLE_SYSTEM *src, double xpos, double ypos, int w, int h, double range )
+ *\brief replace the particles of dst with a copy of the src particles found in a view, so that another thread can draw them while src is updated. dst only holds what draw_particle needs and must not be managed
+ *\param dst particle system receiving the copy
+ *\param src particle system to copy
+ *\param xpos view x position
+ *\param ypos view y position
+ *\param w view width
+ *\param h view height
+ *\param range view border tolerance, as in draw_particle
+ *\return number of copied particles, or -1 on error
+ */
+int copy_visible_particles(PARTICLE_SYSTEM* dst, const PARTICLE_SYSTEM* src, double xpos, double ypos, int w, int h, double range) {
+    __n_assert(dst, return -1);
+    __n_assert(src, return -1);
+
+    dst->nb_particles = 0;
+    if (reserve_particles(dst, src->nb_particles) != TRUE)
+        return -1;
+
+    int nb_sprites = (dst->max_sprites < src->max_sprites) ? dst->max_sprites : src->max_sprites;
+    for (int it = 0; it < nb_sprites; it++)
+        dst->sprites[it] = src->sprites[it];
+
+    int nb = 0;
+    for (int id = 0; id < src->nb_particles; id++) {
+        double x = src->position[id][0] - xpos;
+        double y = src->position[id][1] - ypos;
+        if ((x < -range) || (x > (w + range)) || (y < -range) || (y > (h + range)))
+            continue;
+
+        dst->mode[nb] = src->mode[id];
+        dst->spr_id[nb] = src->spr_id[id];
+        dst->size[nb] = src->size[id];
+        dst->color[nb] = src->color[id];
+        memcpy(dst->position[nb], src->position[id], sizeof(VECTOR3D));
+        memcpy(dst->previous_position[nb], src->previous_position[id], sizeof(VECTOR3D));
+        memcpy(dst->speed[nb], src->speed[id], sizeof(VECTOR3D));
+        memcpy(dst->orientation[nb], src->orientation[id], sizeof(VECTOR3D));
+        nb++;
+    }
+    dst->nb_particles = nb;
+
+    return nb;
+} /* copy_visible_particles() */
+
 /*!\fn int free_particle_system( PARTICLE_SYSTEM **psys)
  *\brief destroy and free a particle system
  *\param psys a pointer to the particle system to destroy
@@ -236,11 +888,27 @@ int draw_particle(PARTICLE_SYSTEM* psys, double xpos, double ypos, int w, int h,
 int free_particle_system(PARTICLE_SYSTEM** psys) {
     __n_assert((*psys), return FALSE);
 
-    PARTICLE* particle = NULL;
-    while ((*psys)->list->start) {
-        particle = remove_list_node((*psys)->list, (*psys)->list->start, PARTICLE);
-        Free(particle);
-    }
+    FreeNoLog((*psys)->mode);
+    FreeNoLog((*psys)->lifetime);
+    FreeNoLog((*psys)->spr_id);
+    FreeNoLog((*psys)->size);
+    FreeNoLog((*psys)->color);
+    FreeNoLog((*psys)->position);
+    FreeNoLog((*psys)->previous_position);
+    FreeNoLog((*psys)->speed);
+    FreeNoLog((*psys)->acceleration);
+    FreeNoLog((*psys)->gravity);
+    FreeNoLog((*psys)->orientation);
+    FreeNoLog((*psys)->angular_speed);
+    FreeNoLog((*psys)->angular_acceleration);
+    FreeNoLog((*psys)->wheel_expire);
+    FreeNoLog((*psys)->wheel_bucket);
+    FreeNoLog((*psys)->wheel_next);
+    FreeNoLog((*psys)->wheel_prev);
+    FreeNoLog((*psys)->sprites);
+    FreeNoLog((*psys)->quad_vertices);
+    FreeNoLog((*psys)->quad_indices);
+    FreeNoLog((*psys)->circle_vertices);
     Free((*psys));
 
     return TRUE;
@@ -257,17 +925,137 @@ int free_particle_system(PARTICLE_SYSTEM** psys) {
 int move_particles(PARTICLE_SYSTEM* psys, double vx, double vy, double vz) {
     __n_assert(psys, return FALSE);
 
-    LIST_NODE* node = NULL;
-    PARTICLE* ptr = NULL;
+    for (int it = 0; it < psys->nb_particles; it++) {
+        psys->position[it][0] = psys->position[it][0] + vx;
+        psys->position[it][1] = psys->position[it][1] + vy;
+        psys->position[it][2] = psys->position[it][2] + vz;
+        psys->previous_position[it][0] = psys->previous_position[it][0] + vx;
+        psys->previous_position[it][1] = psys->previous_position[it][1] + vy;
+        psys->previous_position[it][2] = psys->previous_position[it][2] + vz;
+    }
+    return TRUE;
+} /* move_particles() */
 
-    node = psys->list->start;
+/*!\fn int init_particle_governor( PARTICLE_GOVERNOR *gov, PARTICLE_SYSTEM *psys, double budget )
+ *\brief initialize an emission governor, at full quality and without categories
+ *\param gov the governor to initialize
+ *\param psys the governed particle system. Its nb_max_particles is the hard cap on live particles
+ *\param budget cost budget, in the unit of the measures given to update_particle_governor. Zero or negative to only apply the caps
+ *\return TRUE or FALSE
+ */
+int init_particle_governor(PARTICLE_GOVERNOR* gov, PARTICLE_SYSTEM* psys, double budget) {
+    __n_assert(gov, return FALSE);
+    __n_assert(psys, return FALSE);
 
-    while (node) {
-        ptr = (PARTICLE*)node->ptr;
-        ptr->object.position[0] = ptr->object.position[0] + vx;
-        ptr->object.position[1] = ptr->object.position[1] + vy;
-        ptr->object.position[2] = ptr->object.position[2] + vz;
-        node = node->next;
+    memset(gov, 0, sizeof(PARTICLE_GOVERNOR));
+    gov->psys = psys;
+    gov->budget = budget;
+    gov->cost = 0.0;
+    gov->quality = 1.0;
+
+    return TRUE;
+} /* init_particle_governor() */
+
+/*!\fn int add_particle_category( PARTICLE_GOVERNOR *gov, int priority, double min_rate, int max_per_update )
+ *\brief add an emission category to a governor. Categories of higher priorities are throttled later and may fill more of the system: a category stops emitting once the live particles reach ( 1 + priority ) / ( 1 + highest priority ) of nb_max_particles
+ *\param gov targeted governor
+ *\param priority priority, from 0 for ambient particles
+ *\param min_rate rate the category never goes under, from 0.0 to 1.0
+ *\param max_per_update hard cap on the particles emitted between two governor updates, zero or negative for none
+ *\return the category id, or -1 on error
+ */
+int add_particle_category(PARTICLE_GOVERNOR* gov, int priority, double min_rate, int max_per_update) {
+    __n_assert(gov, return -1);
+
+    if (gov->nb_categories >= PARTICLE_MAX_CATEGORIES) {
+        n_log(LOG_ERR, "no room for a new particle category, %d max", PARTICLE_MAX_CATEGORIES);
+        return -1;
     }
+    if (priority < 0)
+        priority = 0;
+
+    PARTICLE_CATEGORY* category = &gov->categories[gov->nb_categories];
+    category->priority = priority;
+    category->min_rate = (min_rate < 0.0) ? 0.0 : (min_rate > 1.0) ? 1.0 : min_rate;
+    category->max_per_update = max_per_update;
+    category->rate = 1.0;
+    category->carry = 0.0;
+    category->emitted = 0;
+    gov->nb_categories++;
+
+    // shares of the system depend on the highest priority
+    int max_priority = 0;
+    for (int it = 0; it < gov->nb_categories; it++) {
+        if (gov->categories[it].priority > max_priority)
+            max_priority = gov->categories[it].priority;
+    }
+    for (int it = 0; it < gov->nb_categories; it++)
+        gov->categories[it].fill_limit = (1.0 + gov->categories[it].priority) / (1.0 + max_priority);
+
+    return gov->nb_categories - 1;
+} /* add_particle_category() */
+
+/*!\fn int update_particle_governor( PARTICLE_GOVERNOR *gov, double cost )
+ *\brief feed the governor with a measure of the particles cost, and start a new emission period. The quality drops quickly while the smoothed cost is over budget, and comes back slowly once it is well under
+ *\param gov targeted governor
+ *\param cost measured particles cost since the last update, in the unit of the budget
+ *\return TRUE or FALSE
+ */
+int update_particle_governor(PARTICLE_GOVERNOR* gov, double cost) {
+    __n_assert(gov, return FALSE);
+
+    if (gov->budget > 0.0) {
+        gov->cost += (cost - gov->cost) * PARTICLE_GOVERNOR_SMOOTHING;
+        if (gov->cost > gov->budget) {
+            gov->quality *= PARTICLE_GOVERNOR_DECREASE;
+            if (gov->quality < PARTICLE_GOVERNOR_MIN_QUALITY)
+                gov->quality = PARTICLE_GOVERNOR_MIN_QUALITY;
+        } else if (gov->cost < gov->budget * PARTICLE_GOVERNOR_RECOVER) {
+            gov->quality += PARTICLE_GOVERNOR_INCREASE;
+            if (gov->quality > 1.0)
+                gov->quality = 1.0;
+        }
+    }
+
+    for (int it = 0; it < gov->nb_categories; it++) {
+        PARTICLE_CATEGORY* category = &gov->categories[it];
+        category->rate = gov->quality * (1 + category->priority);
+        if (category->rate > 1.0)
+            category->rate = 1.0;
+        if (category->rate < category->min_rate)
+            category->rate = category->min_rate;
+        category->emitted = 0;
+    }
+
     return TRUE;
-}
+} /* update_particle_governor() */
+
+/*!\fn int particle_governor_emit( PARTICLE_GOVERNOR *gov, int category, int requested )
+ *\brief get how many of the requested particles of a category to emit now. Fractions of particles are carried over, so a category at half rate asking for one particle per call emits one every two calls
+ *\param gov targeted governor
+ *\param category category id from add_particle_category
+ *\param requested number of particles the caller would emit at full quality
+ *\return the number of particles to emit, from 0 to requested
+ */
+int particle_governor_emit(PARTICLE_GOVERNOR* gov, int category, int requested) {
+    __n_assert(gov, return 0);
+
+    if (category < 0 || category >= gov->nb_categories || requested <= 0)
+        return 0;
+
+    PARTICLE_CATEGORY* current = &gov->categories[category];
+    PARTICLE_SYSTEM* psys = gov->psys;
+    if (psys->nb_max_particles > 0 && psys->nb_particles >= current->fill_limit * psys->nb_max_particles)
+        return 0;
+
+    current->carry += requested * current->rate;
+    int count = (int)current->carry;
+    current->carry -= count;
+    if (current->max_per_update > 0 && current->emitted + count > current->max_per_update)
+        count = current->max_per_update - current->emitted;
+    if (count < 0)
+        count = 0;
+    current->emitted += count;
+
+    return count;
+} /* particle_governor_emit() */
@@ -0,0 +1,238 @@
+/**\file n_profile.c
+ *  Zone profiler functions
+ *\author Castagnier Mickael
+ *\version 1.0
+ *\date 16/10/2026
+ */
+
+#include "nilorea/n_common.h"
+#include "nilorea/n_log.h"
+#include "nilorea/n_profile.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*! Internal: zones storage */
+static N_PROFILE_ZONE profile_zones[N_PROFILE_MAX_ZONES];
+/*! Internal: number of zones */
+static int profile_nb_zones = 0;
+/*! Internal: timer started with the profiler, timings are relative to it */
+static N_TIME profile_origin;
+/*! Internal: set once profile_origin is started */
+static int profile_started = 0;
+/*! Internal: recording switch */
+static int profile_enabled = 1;
+/*! Internal: number of threads that recorded a timing */
+static int profile_nb_threads = 0;
+/*! Internal: id of the current thread, -1 before its first record */
+static __thread int profile_thread = -1;
+/*! Internal: lock on zones and threads */
+static pthread_mutex_t profile_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*!\fn static void n_profile_start( void )
+ *\brief Internal: start the profiler timer on first use
+ */
+static void n_profile_start(void) {
+    if (__atomic_load_n(&profile_started, __ATOMIC_ACQUIRE))
+        return;
+    pthread_mutex_lock(&profile_lock);
+    if (!profile_started) {
+        start_HiTimer(&profile_origin);
+        __atomic_store_n(&profile_started, 1, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&profile_lock);
+} /* n_profile_start() */
+
+/*!\fn int n_profile_zone( const char *name )
+ *\brief get the id of a zone, creating it on first use
+ *\param name zone name, truncated to N_PROFILE_NAME_SIZE - 1 characters
+ *\return zone id, or -1 if there is no room for a new zone
+ */
+int n_profile_zone(const char* name) {
+    __n_assert(name, return -1);
+
+    n_profile_start();
+
+    int zone = -1;
+    pthread_mutex_lock(&profile_lock);
+    for (int it = 0; it < profile_nb_zones; it++) {
+        if (!strncmp(profile_zones[it].name, name, N_PROFILE_NAME_SIZE - 1)) {
+            zone = it;
+            break;
+        }
+    }
+    if (zone == -1 && profile_nb_zones < N_PROFILE_MAX_ZONES) {
+        N_PROFILE_ZONE* new_zone = &profile_zones[profile_nb_zones];
+        new_zone->ring = (N_PROFILE_SAMPLE*)calloc(N_PROFILE_RING_SIZE, sizeof(N_PROFILE_SAMPLE));
+        if (new_zone->ring) {
+            strncpy(new_zone->name, name, N_PROFILE_NAME_SIZE - 1);
+            new_zone->name[N_PROFILE_NAME_SIZE - 1] = '\0';
+            new_zone->next = 0;
+            new_zone->nb_samples = 0;
+            zone = profile_nb_zones++;
+        } else {
+            n_log(LOG_ERR, "could not allocate profile zone %s", name);
+        }
+    } else if (zone == -1) {
+        n_log(LOG_ERR, "no room for profile zone %s, %d zones max", name, N_PROFILE_MAX_ZONES);
+    }
+    pthread_mutex_unlock(&profile_lock);
+
+    return zone;
+} /* n_profile_zone() */
+
+/*!\fn int64_t n_profile_now( void )
+ *\brief nsecs elapsed since the profiler start, read from a copy of the profiler N_TIME so that it is never reset
+ *\return elapsed nsecs
+ */
+int64_t n_profile_now(void) {
+    n_profile_start();
+    N_TIME now = profile_origin;
+    return (int64_t)get_nsec(&now);
+} /* n_profile_now() */
+
+/*!\fn void n_profile_record( int zone, int64_t start, int64_t end )
+ *\brief add a timing to a zone ring buffer, overwriting the oldest one when it is full
+ *\param zone zone id from n_profile_zone
+ *\param start start of the timing, from n_profile_now
+ *\param end end of the timing, from n_profile_now
+ */
+void n_profile_record(int zone, int64_t start, int64_t end) {
+    if (zone < 0 || !__atomic_load_n(&profile_enabled, __ATOMIC_RELAXED))
+        return;
+
+    pthread_mutex_lock(&profile_lock);
+    if (zone < profile_nb_zones) {
+        if (profile_thread == -1)
+            profile_thread = profile_nb_threads++;
+        N_PROFILE_ZONE* current = &profile_zones[zone];
+        N_PROFILE_SAMPLE* sample = &current->ring[current->next];
+        sample->start = start;
+        sample->duration = end - start;
+        sample->thread = profile_thread;
+        current->next = (current->next + 1) % N_PROFILE_RING_SIZE;
+        if (current->nb_samples < N_PROFILE_RING_SIZE)
+            current->nb_samples++;
+    }
+    pthread_mutex_unlock(&profile_lock);
+} /* n_profile_record() */
+
+/*!\fn void n_profile_enable( bool enabled )
+ *\brief turn the recording on or off. Zones keep their timings
+ *\param enabled true to record
+ */
+void n_profile_enable(bool enabled) {
+    __atomic_store_n(&profile_enabled, enabled ? 1 : 0, __ATOMIC_RELAXED);
+} /* n_profile_enable() */
+
+/*!\fn int n_profile_nb_zones( void )
+ *\brief get the number of zones, ids going from 0 to n_profile_nb_zones() - 1
+ *\return number of zones
+ */
+int n_profile_nb_zones(void) {
+    pthread_mutex_lock(&profile_lock);
+    int nb = profile_nb_zones;
+    pthread_mutex_unlock(&profile_lock);
+    return nb;
+} /* n_profile_nb_zones() */
+
+/*!\fn static int n_profile_compare( const void *a, const void *b )
+ *\brief Internal: qsort callback ordering durations
+ */
+static int n_profile_compare(const void* a, const void* b) {
+    int64_t da = *(const int64_t*)a;
+    int64_t db = *(const int64_t*)b;
+    return (da > db) - (da < db);
+} /* n_profile_compare() */
+
+/*!\fn int n_profile_get_stats( int zone, N_PROFILE_STATS *stats )
+ *\brief summarize the kept timings of a zone
+ *\param zone zone id
+ *\param stats summary to fill. Durations are zero if the zone has no timing yet
+ *\return TRUE or FALSE
+ */
+int n_profile_get_stats(int zone, N_PROFILE_STATS* stats) {
+    __n_assert(stats, return FALSE);
+
+    int64_t durations[N_PROFILE_RING_SIZE];
+    int nb = 0;
+
+    pthread_mutex_lock(&profile_lock);
+    if (zone < 0 || zone >= profile_nb_zones) {
+        pthread_mutex_unlock(&profile_lock);
+        return FALSE;
+    }
+    N_PROFILE_ZONE* current = &profile_zones[zone];
+    stats->name = current->name;
+    nb = current->nb_samples;
+    for (int it = 0; it < nb; it++)
+        durations[it] = current->ring[it].duration;
+    pthread_mutex_unlock(&profile_lock);
+
+    stats->nb_samples = nb;
+    if (nb == 0) {
+        stats->p50 = stats->p95 = stats->p99 = stats->max = 0;
+        return TRUE;
+    }
+    qsort(durations, nb, sizeof(int64_t), n_profile_compare);
+    stats->p50 = durations[nb * 50 / 100];
+    stats->p95 = durations[nb * 95 / 100];
+    stats->p99 = durations[nb * 99 / 100];
+    stats->max = durations[nb - 1];
+
+    return TRUE;
+} /* n_profile_get_stats() */
+
+/*!\fn int n_profile_dump_trace( const char *filename )
+ *\brief write all the kept timings as complete events of a Chrome trace-event JSON file, to open in chrome://tracing or Perfetto
+ *\param filename output file
+ *\return TRUE or FALSE
+ */
+int n_profile_dump_trace(const char* filename) {
+    __n_assert(filename, return FALSE);
+
+    FILE* out = fopen(filename, "w");
+    if (!out) {
+        n_log(LOG_ERR, "could not create trace file %s", filename);
+        return FALSE;
+    }
+
+    fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    bool first = true;
+    pthread_mutex_lock(&profile_lock);
+    for (int zone = 0; zone < profile_nb_zones; zone++) {
+        N_PROFILE_ZONE* current = &profile_zones[zone];
+        // oldest first
+        int oldest = (current->nb_samples < N_PROFILE_RING_SIZE) ? 0 : current->next;
+        for (int it = 0; it < current->nb_samples; it++) {
+            N_PROFILE_SAMPLE* sample = &current->ring[(oldest + it) % N_PROFILE_RING_SIZE];
+            // trace timestamps are in usecs
+            fprintf(out, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", first ? "" : ",", current->name, sample->thread, sample->start / 1000.0, sample->duration / 1000.0);
+            first = false;
+        }
+    }
+    pthread_mutex_unlock(&profile_lock);
+    fprintf(out, "\n]}\n");
+
+    if (fclose(out) != 0) {
+        n_log(LOG_ERR, "could not write trace file %s", filename);
+        return FALSE;
+    }
+    return TRUE;
+} /* n_profile_dump_trace() */
+
+/*!\fn void n_profile_free( void )
+ *\brief free all the zones. Zone ids cached by N_PROFILE_BEGIN are no longer valid afterward
+ */
+void n_profile_free(void) {
+    pthread_mutex_lock(&profile_lock);
+    for (int it = 0; it < profile_nb_zones; it++) {
+        FreeNoLog(profile_zones[it].ring);
+        profile_zones[it].nb_samples = 0;
+        profile_zones[it].next = 0;
+    }
+    profile_nb_zones = 0;
+    pthread_mutex_unlock(&profile_lock);
+} /* n_profile_free() */
@@ -11,6 +11,24 @@
 #include <stdlib.h>
 #include <unistd.h>
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#include <x86intrin.h>
+/*! the time stamp counter can be read on this target */
+#define N_TIME_HAVE_TSC
+#endif
+
+/*! Internal: clock used by the N_TIME timers, N_TIME_CLOCK_MONOTONIC or N_TIME_CLOCK_TSC */
+static int time_source = N_TIME_CLOCK_MONOTONIC;
+/*! Internal: calibrated time stamp counter frequency in Hz, 0 until calibrated */
+static double tsc_frequency = 0.0;
+/*! Internal: nsecs per time stamp counter cycle */
+static double tsc_nsec_per_cycle = 0.0;
+/*! Internal: cycle count at calibration */
+static uint64_t tsc_base_cycles = 0;
+/*! Internal: monotonic time at calibration, in nsecs */
+static int64_t tsc_base_nsec = 0;
+
 #if defined(__windows__)
 /*!\fn void u_sleep( __int64 usec)
  *\brief u_sleep for windows
@@ -59,6 +77,125 @@ void PAUSE(void) {
     printf("\n");
 } /* PAUSE(...) */
 
+/*!\fn static int64_t monotonic_nsec( void )
+ *\brief Internal: read the monotonic clock, unaffected by wall clock changes. CLOCK_MONOTONIC_RAW is not slewed by NTP either
+ *\return nsecs since an unspecified start
+ */
+static int64_t monotonic_nsec(void) {
+#ifdef __windows__
+    static LARGE_INTEGER freq = {.QuadPart = 0};
+    LARGE_INTEGER counter;
+    if (freq.QuadPart == 0)
+        QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&counter);
+    // split to avoid overflowing counter * 1e9
+    return (int64_t)(counter.QuadPart / freq.QuadPart) * 1000000000 + (int64_t)(counter.QuadPart % freq.QuadPart) * 1000000000 / freq.QuadPart;
+#else
+    struct timespec now;
+#ifdef CLOCK_MONOTONIC_RAW
+    clock_gettime(CLOCK_MONOTONIC_RAW, &now);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &now);
+#endif
+    return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+#endif
+} /* monotonic_nsec() */
+
+/*!\fn uint64_t get_cycles( void )
+ *\brief read the CPU time stamp counter. Falls back to monotonic nsecs on targets without one
+ *\return current cycle count
+ */
+uint64_t get_cycles(void) {
+#ifdef N_TIME_HAVE_TSC
+    return __rdtsc();
+#else
+    return (uint64_t)monotonic_nsec();
+#endif
+} /* get_cycles() */
+
+/*!\fn static int calibrate_tsc( void )
+ *\brief Internal: measure the time stamp counter frequency against the monotonic clock over 20 msecs
+ *\return TRUE or FALSE
+ */
+static int calibrate_tsc(void) {
+#ifdef N_TIME_HAVE_TSC
+    // an invariant TSC ticks at a constant rate whatever the power state
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+    if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) || !(edx & (1 << 8))) {
+        n_log(LOG_ERR, "no invariant time stamp counter on this CPU");
+        return FALSE;
+    }
+    int64_t start_nsec = monotonic_nsec();
+    uint64_t start_cycles = __rdtsc();
+    u_sleep(20000);
+    int64_t end_nsec = monotonic_nsec();
+    uint64_t end_cycles = __rdtsc();
+    if (end_nsec <= start_nsec || end_cycles <= start_cycles) {
+        n_log(LOG_ERR, "time stamp counter calibration failed");
+        return FALSE;
+    }
+    tsc_frequency = (double)(end_cycles - start_cycles) * 1000000000.0 / (double)(end_nsec - start_nsec);
+    tsc_nsec_per_cycle = 1000000000.0 / tsc_frequency;
+    tsc_base_cycles = end_cycles;
+    tsc_base_nsec = end_nsec;
+    n_log(LOG_DEBUG, "time stamp counter calibrated at %.0f Hz", tsc_frequency);
+    return TRUE;
+#else
+    n_log(LOG_ERR, "no time stamp counter on this target");
+    return FALSE;
+#endif
+} /* calibrate_tsc() */
+
+/*!\fn double get_cycles_frequency( void )
+ *\brief get the time stamp counter frequency, calibrating it on first call
+ *\return cycles per second, 0.0 if there is no usable time stamp counter
+ */
+double get_cycles_frequency(void) {
+    if (tsc_frequency == 0.0)
+        calibrate_tsc();
+    return tsc_frequency;
+} /* get_cycles_frequency() */
+
+/*!\fn int set_time_source( int source )
+ *\brief choose the clock of all the N_TIME timers. Call it before starting any timer
+ *\param source N_TIME_CLOCK_MONOTONIC (default) or N_TIME_CLOCK_TSC, which is calibrated when selected
+ *\return TRUE or FALSE if the source is not available, the current one being kept
+ */
+int set_time_source(int source) {
+    if (source == N_TIME_CLOCK_MONOTONIC) {
+        time_source = source;
+        return TRUE;
+    }
+    if (source == N_TIME_CLOCK_TSC) {
+        if (tsc_frequency == 0.0 && calibrate_tsc() != TRUE)
+            return FALSE;
+        time_source = source;
+        return TRUE;
+    }
+    n_log(LOG_ERR, "unknown time source %d", source);
+    return FALSE;
+} /* set_time_source() */
+
+/*!\fn int get_time_source( void )
+ *\brief get the clock used by the N_TIME timers
+ *\return N_TIME_CLOCK_MONOTONIC or N_TIME_CLOCK_TSC
+ */
+int get_time_source(void) {
+    return time_source;
+} /* get_time_source() */
+
+/*!\fn int64_t get_time_nsec( void )
+ *\brief read the clock of the N_TIME timers
+ *\return nsecs since an unspecified start
+ */
+int64_t get_time_nsec(void) {
+#ifdef N_TIME_HAVE_TSC
+    if (time_source == N_TIME_CLOCK_TSC)
+        return tsc_base_nsec + (int64_t)((double)(__rdtsc() - tsc_base_cycles) * tsc_nsec_per_cycle);
+#endif
+    return monotonic_nsec();
+} /* get_time_nsec() */
+
 /*!\fn int start_HiTimer( N_TIME *timer )
  *\brief Initialize or restart from zero any N_TIME HiTimer
  *\param timer Any N_TIMER *timer you wanna start or reset
@@ -67,37 +204,40 @@ void PAUSE(void) {
 int start_HiTimer(N_TIME* timer) {
     /* set delta to 0 */
     timer->delta = 0;
-
-#if defined(__windows__)
-    if (QueryPerformanceFrequency((LARGE_INTEGER*)&timer->freq) == 0)
-        return FALSE;
-    if (QueryPerformanceCounter(&timer->startTime) == 0)
-        return FALSE;
-#else
-    if (gettimeofday(&timer->startTime, 0) != 0)
-        return FALSE;
-#endif
+    timer->startTime = timer->currentTime = get_time_nsec();
 
     return TRUE;
 } /* init_HiTimer(...) */
 
+/*!\fn static int64_t poll_HiTimer( N_TIME *timer )
+ *\brief Internal: read the clock, moving currentTime to startTime
+ *\param timer timer to poll
+ *\return elapsed nsecs since the last poll
+ */
+static int64_t poll_HiTimer(N_TIME* timer) {
+    timer->currentTime = get_time_nsec();
+    int64_t elapsed = timer->currentTime - timer->startTime;
+    timer->startTime = timer->currentTime;
+    return elapsed;
+} /* poll_HiTimer() */
+
+/*!\fn time_t get_nsec( N_TIME  *timer )
+ *\brief Poll any N_TIME HiTimer, returning nsec, and moving currentTime to startTime
+ *\param timer Any N_TIMER *timer you wanna poll
+ *\return The elapsed number of nsec for the given N_TIME *timer
+ */
+time_t get_nsec(N_TIME* timer) {
+    timer->delta = (time_t)poll_HiTimer(timer);
+    return timer->delta;
+} /* get_nsec( ... ) */
+
 /*!\fn time_t get_usec( N_TIME  *timer )
  *\brief Poll any N_TIME HiTimer, returning usec, and moving currentTime to startTime
  *\param timer Any N_TIMER *timer you wanna poll
  *\return The elapsed number of usec for the given N_TIME *timer
  */
 time_t get_usec(N_TIME* timer) {
-#ifdef __windows__
-    QueryPerformanceCounter((LARGE_INTEGER*)&timer->currentTime);
-    timer->delta = 1000000 * (timer->currentTime.QuadPart - timer->startTime.QuadPart) / timer->freq.QuadPart;
-    timer->startTime = timer->currentTime;
-#else
-    gettimeofday(&timer->currentTime, 0);
-    timer->delta = (timer->currentTime.tv_sec - timer->startTime.tv_sec) * 1000000 + (timer->currentTime.tv_usec - timer->startTime.tv_usec);
-    timer->startTime.tv_sec = timer->currentTime.tv_sec;
-    timer->startTime.tv_usec = timer->currentTime.tv_usec;
-#endif
-
+    timer->delta = (time_t)(poll_HiTimer(timer) / 1000);
     return timer->delta;
 } /* get_usec( ... ) */
 
@@ -107,17 +247,7 @@ time_t get_usec(N_TIME* timer) {
  *\return The elapsed number of msec for the given N_TIME *timer
  */
 time_t get_msec(N_TIME* timer) {
-#ifdef __windows__
-    QueryPerformanceCounter((LARGE_INTEGER*)&timer->currentTime);
-    timer->delta = 1000 * (timer->currentTime.QuadPart - timer->startTime.QuadPart) / timer->freq.QuadPart;
-    timer->startTime = timer->currentTime;
-#else
-    gettimeofday(&timer->currentTime, 0);
-    timer->delta = (timer->currentTime.tv_sec - timer->startTime.tv_sec) * 1000 + (timer->currentTime.tv_usec - timer->startTime.tv_usec) / 1000;
-    timer->startTime.tv_sec = timer->currentTime.tv_sec;
-    timer->startTime.tv_usec = timer->currentTime.tv_usec;
-#endif
-
+    timer->delta = (time_t)(poll_HiTimer(timer) / 1000000);
     return timer->delta;
 } /* get_msec(...) */
 
@@ -127,15 +257,6 @@ time_t get_msec(N_TIME* timer) {
  *\return The elapsed number of sec for the given N_TIME *timer
  */
 time_t get_sec(N_TIME* timer) {
-#ifdef __windows__
-    QueryPerformanceCounter((LARGE_INTEGER*)&timer->currentTime);
-    timer->delta = (timer->currentTime.QuadPart - timer->startTime.QuadPart) / timer->freq.QuadPart;
-    timer->startTime = timer->currentTime;
-#else
-    gettimeofday(&timer->currentTime, 0);
-    timer->delta = (timer->currentTime.tv_sec - timer->startTime.tv_sec) + (timer->currentTime.tv_usec - timer->startTime.tv_usec) / 1000000;
-    timer->startTime.tv_sec = timer->currentTime.tv_sec;
-    timer->startTime.tv_usec = timer->currentTime.tv_usec;
-#endif
+    timer->delta = (time_t)(poll_HiTimer(timer) / 1000000000);
     return timer->delta;
 } /* get_sec(...) */
@@ -1,8 +1,15 @@
 #include "sledge_physics.h"
 #include <math.h>
 #include <stdio.h>
+#include "nilorea/n_3d.h"
+#include "nilorea/n_common.h"
 #include "nilorea/n_log.h"
 
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define SLEDGE_HAVE_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
 void calculate_perpendicular_points(double x, double y, double direction, double distance, double* x1, double* y1, double* x2, double* y2) {
     // Convert direction to radians
     double angleRad = DEG_TO_RAD(direction);
@@ -170,6 +177,306 @@ void print_vehicle(const VEHICLE* vehicle) {
           vehicle->x, vehicle->y, vehicle->speed, vehicle->direction);
 }
 
+// Allocate a batch, all its arrays in one block
+bool init_vehicle_batch(VEHICLE_BATCH* batch, int max_vehicles) {
+    __n_assert(batch, return false);
+
+    double* block = NULL;
+    Malloc(block, double, 14 * max_vehicles);
+    __n_assert(block, return false);
+    double** fields[14] = {&batch->x, &batch->y, &batch->speed, &batch->direction, &batch->angular_velocity, &batch->slip_angle, &batch->handbrake,
+                           &batch->slip_factor, &batch->angular_velocity_multiplier, &batch->drag_multiplier, &batch->slip_angle_limits,
+                           &batch->trig_angle, &batch->trig_cos, &batch->trig_sin};
+    for (int it = 0; it < 14; it++)
+        *fields[it] = block + it * max_vehicles;
+    batch->nb_vehicles = 0;
+    batch->max_vehicles = max_vehicles;
+    return true;
+}
+
+// Copy a vehicle at the end of a batch
+int add_vehicle_to_batch(VEHICLE_BATCH* batch, const VEHICLE* vehicle) {
+    __n_assert(batch, return -1);
+    __n_assert(vehicle, return -1);
+    if (batch->nb_vehicles >= batch->max_vehicles)
+        return -1;
+
+    int i = batch->nb_vehicles++;
+    batch->x[i] = vehicle->x;
+    batch->y[i] = vehicle->y;
+    batch->speed[i] = vehicle->speed;
+    batch->direction[i] = vehicle->direction;
+    batch->angular_velocity[i] = vehicle->angular_velocity;
+    batch->slip_angle[i] = vehicle->slip_angle;
+    batch->handbrake[i] = vehicle->handbrake;
+    batch->slip_factor[i] = vehicle->slip_factor;
+    batch->angular_velocity_multiplier[i] = vehicle->angular_velocity_multiplier;
+    batch->drag_multiplier[i] = vehicle->drag_multiplier;
+    batch->slip_angle_limits[i] = vehicle->slip_angle_limits;
+    return i;
+}
+
+// Copy a vehicle of a batch back to a VEHICLE
+void get_vehicle_from_batch(const VEHICLE_BATCH* batch, int index, VEHICLE* vehicle) {
+    vehicle->x = batch->x[index];
+    vehicle->y = batch->y[index];
+    vehicle->speed = batch->speed[index];
+    vehicle->direction = batch->direction[index];
+    vehicle->angular_velocity = batch->angular_velocity[index];
+    vehicle->slip_angle = batch->slip_angle[index];
+    vehicle->handbrake = batch->handbrake[index];
+    vehicle->slip_factor = batch->slip_factor[index];
+    vehicle->angular_velocity_multiplier = batch->angular_velocity_multiplier[index];
+    vehicle->drag_multiplier = batch->drag_multiplier[index];
+    vehicle->slip_angle_limits = batch->slip_angle_limits[index];
+}
+
+// Batched sine and cosine: reduction by the nearest multiple of pi/2 in three parts (Cody-Waite), then the fdlibm
+// polynomials on [-pi/4, pi/4]. The scalar, SSE2 and AVX2 versions run the same operations, so they give the same
+// results, within one ulp of libm. Angles beyond TRIG_BATCH_MAX_ANGLE, infinite or NaN go to libm
+#define TRIG_BATCH_MAX_ANGLE 1.0e5
+// round to nearest integer for |x| < 2^51: the addition drops the fraction, the low bits of the sum hold the integer
+#define TRIG_BATCH_ROUND 6755399441055744.0
+#define TRIG_2_OVER_PI 6.36619772367581382433e-01
+#define TRIG_PIO2_1 1.57079632673412561417e+00
+#define TRIG_PIO2_2 6.07710050630396597660e-11
+#define TRIG_PIO2_3 2.02226624879595063154e-21
+#define TRIG_S1 -1.66666666666666324348e-01
+#define TRIG_S2 8.33333333332248946124e-03
+#define TRIG_S3 -1.98412698298579493134e-04
+#define TRIG_S4 2.75573137070700676789e-06
+#define TRIG_S5 -2.50507602534068634195e-08
+#define TRIG_S6 1.58969099521155010221e-10
+#define TRIG_C1 4.16666666666666019037e-02
+#define TRIG_C2 -1.38888888888741095749e-03
+#define TRIG_C3 2.48015872894767294178e-05
+#define TRIG_C4 -2.75573143513906633035e-07
+#define TRIG_C5 2.08757232129817482790e-09
+#define TRIG_C6 -1.13596475577881948265e-11
+
+// sine and cosine of angle[start] to angle[nb - 1]
+static void sincos_batch_scalar(const double* angle, double* cosine, double* sine, size_t start, size_t nb) {
+    for (size_t it = start; it < nb; it++) {
+        double x = angle[it];
+        if (!(fabs(x) <= TRIG_BATCH_MAX_ANGLE)) {
+            cosine[it] = cos(x);
+            sine[it] = sin(x);
+            continue;
+        }
+        double rounded = x * TRIG_2_OVER_PI + TRIG_BATCH_ROUND;
+        double q = rounded - TRIG_BATCH_ROUND;
+        long long quadrant = (long long)q;
+        double r = ((x - q * TRIG_PIO2_1) - q * TRIG_PIO2_2) - q * TRIG_PIO2_3;
+        double z = r * r;
+        double s = r + (z * r) * (TRIG_S1 + z * (TRIG_S2 + z * (TRIG_S3 + z * (TRIG_S4 + z * (TRIG_S5 + z * TRIG_S6)))));
+        double hz = 0.5 * z;
+        double w = 1.0 - hz;
+        double c = w + (((1.0 - w) - hz) + (z * z) * (TRIG_C1 + z * (TRIG_C2 + z * (TRIG_C3 + z * (TRIG_C4 + z * (TRIG_C5 + z * TRIG_C6))))));
+        double sin_r = (quadrant & 1) ? c : s;
+        double cos_r = (quadrant & 1) ? s : c;
+        sine[it] = ((quadrant & 2) ? -sin_r : sin_r);
+        cosine[it] = (((quadrant + 1) & 2) ? -cos_r : cos_r);
+    }
+}
+
+#ifdef SLEDGE_HAVE_X86_SIMD
+// same as sincos_batch_scalar, two angles per iteration. The quadrant is read from the rounding sum bits: its bit 0
+// swaps sine and cosine, its bit 1 flips the sine sign, and bit 1 of quadrant + 1 flips the cosine sign
+__attribute__((target("sse2"))) static void sincos_batch_sse2(const double* angle, double* cosine, double* sine, size_t nb) {
+    const __m128d abs_mask = _mm_castsi128_pd(_mm_set1_epi64x(0x7FFFFFFFFFFFFFFFLL));
+    const __m128i one = _mm_set1_epi64x(1);
+    size_t it = 0;
+    for (; it + 2 <= nb; it += 2) {
+        __m128d x = _mm_loadu_pd(angle + it);
+        // out of range or not finite: the whole pair goes to the scalar version
+        if (_mm_movemask_pd(_mm_cmple_pd(_mm_and_pd(x, abs_mask), _mm_set1_pd(TRIG_BATCH_MAX_ANGLE))) != 3) {
+            sincos_batch_scalar(angle, cosine, sine, it, it + 2);
+            continue;
+        }
+        __m128d rounded = _mm_add_pd(_mm_mul_pd(x, _mm_set1_pd(TRIG_2_OVER_PI)), _mm_set1_pd(TRIG_BATCH_ROUND));
+        __m128d q = _mm_sub_pd(rounded, _mm_set1_pd(TRIG_BATCH_ROUND));
+        __m128i quadrant = _mm_castpd_si128(rounded);
+        __m128d r = _mm_sub_pd(_mm_sub_pd(_mm_sub_pd(x, _mm_mul_pd(q, _mm_set1_pd(TRIG_PIO2_1))), _mm_mul_pd(q, _mm_set1_pd(TRIG_PIO2_2))), _mm_mul_pd(q, _mm_set1_pd(TRIG_PIO2_3)));
+        __m128d z = _mm_mul_pd(r, r);
+
+        __m128d poly = _mm_add_pd(_mm_set1_pd(TRIG_S5), _mm_mul_pd(z, _mm_set1_pd(TRIG_S6)));
+        poly = _mm_add_pd(_mm_set1_pd(TRIG_S4), _mm_mul_pd(z, poly));
+        poly = _mm_add_pd(_mm_set1_pd(TRIG_S3), _mm_mul_pd(z, poly));
+        poly = _mm_add_pd(_mm_set1_pd(TRIG_S2), _mm_mul_pd(z, poly));
+        poly = _mm_add_pd(_mm_set1_pd(TRIG_S1), _mm_mul_pd(z, poly));
+        __m128d s = _mm_add_pd(r, _mm_mul_pd(_mm_mul_pd(z, r), poly));
+
+        poly = _mm_add_pd(_mm_set1_pd(TRIG_C5), _mm_mul_pd(z, _mm_set1_pd(TRIG_C6)));
+        poly = _mm_add_pd(_mm_set1_pd(TRIG_C4), _mm_mul_pd(z, poly));
+        poly = _mm_add_pd(_mm_set1_pd(TRIG_C3), _mm_mul_pd(z, poly));
+        poly = _mm_add_pd(_mm_set1_pd(TRIG_C2), _mm_mul_pd(z, poly));
+        poly = _mm_add_pd(_mm_set1_pd(TRIG_C1), _mm_mul_pd(z, poly));
+        __m128d hz = _mm_mul_pd(_mm_set1_pd(0.5), z);
+        __m128d w = _mm_sub_pd(_mm_set1_pd(1.0), hz);
+        __m128d c = _mm_add_pd(w, _mm_add_pd(_mm_sub_pd(_mm_sub_pd(_mm_set1_pd(1.0), w), hz), _mm_mul_pd(_mm_mul_pd(z, z), poly)));
+
+        __m128d swap = _mm_castsi128_pd(_mm_sub_epi64(_mm_setzero_si128(), _mm_and_si128(quadrant, one)));
+        __m128d sin_r = _mm_or_pd(_mm_and_pd(swap, c), _mm_andnot_pd(swap, s));
+        __m128d cos_r = _mm_or_pd(_mm_and_pd(swap, s), _mm_andnot_pd(swap, c));
+        __m128d sin_sign = _mm_castsi128_pd(_mm_slli_epi64(_mm_srli_epi64(quadrant, 1), 63));
+        __m128d cos_sign = _mm_castsi128_pd(_mm_slli_epi64(_mm_srli_epi64(_mm_add_epi64(quadrant, one), 1), 63));
+        _mm_storeu_pd(sine + it, _mm_xor_pd(sin_r, sin_sign));
+        _mm_storeu_pd(cosine + it, _mm_xor_pd(cos_r, cos_sign));
+    }
+    sincos_batch_scalar(angle, cosine, sine, it, nb);
+}
+
+// same as sincos_batch_sse2, four angles per iteration
+__attribute__((target("avx2"))) static void sincos_batch_avx2(const double* angle, double* cosine, double* sine, size_t nb) {
+    const __m256d abs_mask = _mm256_castsi256_pd(_mm256_set1_epi64x(0x7FFFFFFFFFFFFFFFLL));
+    const __m256i one = _mm256_set1_epi64x(1);
+    size_t it = 0;
+    for (; it + 4 <= nb; it += 4) {
+        __m256d x = _mm256_loadu_pd(angle + it);
+        if (_mm256_movemask_pd(_mm256_cmp_pd(_mm256_and_pd(x, abs_mask), _mm256_set1_pd(TRIG_BATCH_MAX_ANGLE), _CMP_LE_OQ)) != 15) {
+            sincos_batch_scalar(angle, cosine, sine, it, it + 4);
+            continue;
+        }
+        __m256d rounded = _mm256_add_pd(_mm256_mul_pd(x, _mm256_set1_pd(TRIG_2_OVER_PI)), _mm256_set1_pd(TRIG_BATCH_ROUND));
+        __m256d q = _mm256_sub_pd(rounded, _mm256_set1_pd(TRIG_BATCH_ROUND));
+        __m256i quadrant = _mm256_castpd_si256(rounded);
+        __m256d r = _mm256_sub_pd(_mm256_sub_pd(_mm256_sub_pd(x, _mm256_mul_pd(q, _mm256_set1_pd(TRIG_PIO2_1))), _mm256_mul_pd(q, _mm256_set1_pd(TRIG_PIO2_2))), _mm256_mul_pd(q, _mm256_set1_pd(TRIG_PIO2_3)));
+        __m256d z = _mm256_mul_pd(r, r);
+
+        __m256d poly = _mm256_add_pd(_mm256_set1_pd(TRIG_S5), _mm256_mul_pd(z, _mm256_set1_pd(TRIG_S6)));
+        poly = _mm256_add_pd(_mm256_set1_pd(TRIG_S4), _mm256_mul_pd(z, poly));
+        poly = _mm256_add_pd(_mm256_set1_pd(TRIG_S3), _mm256_mul_pd(z, poly));
+        poly = _mm256_add_pd(_mm256_set1_pd(TRIG_S2), _mm256_mul_pd(z, poly));
+        poly = _mm256_add_pd(_mm256_set1_pd(TRIG_S1), _mm256_mul_pd(z, poly));
+        __m256d s = _mm256_add_pd(r, _mm256_mul_pd(_mm256_mul_pd(z, r), poly));
+
+        poly = _mm256_add_pd(_mm256_set1_pd(TRIG_C5), _mm256_mul_pd(z, _mm256_set1_pd(TRIG_C6)));
+        poly = _mm256_add_pd(_mm256_set1_pd(TRIG_C4), _mm256_mul_pd(z, poly));
+        poly = _mm256_add_pd(_mm256_set1_pd(TRIG_C3), _mm256_mul_pd(z, poly));
+        poly = _mm256_add_pd(_mm256_set1_pd(TRIG_C2), _mm256_mul_pd(z, poly));
+        poly = _mm256_add_pd(_mm256_set1_pd(TRIG_C1), _mm256_mul_pd(z, poly));
+        __m256d hz = _mm256_mul_pd(_mm256_set1_pd(0.5), z);
+        __m256d w = _mm256_sub_pd(_mm256_set1_pd(1.0), hz);
+        __m256d c = _mm256_add_pd(w, _mm256_add_pd(_mm256_sub_pd(_mm256_sub_pd(_mm256_set1_pd(1.0), w), hz), _mm256_mul_pd(_mm256_mul_pd(z, z), poly)));
+
+        __m256d swap = _mm256_castsi256_pd(_mm256_sub_epi64(_mm256_setzero_si256(), _mm256_and_si256(quadrant, one)));
+        __m256d sin_r = _mm256_blendv_pd(s, c, swap);
+        __m256d cos_r = _mm256_blendv_pd(c, s, swap);
+        __m256d sin_sign = _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_srli_epi64(quadrant, 1), 63));
+        __m256d cos_sign = _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_srli_epi64(_mm256_add_epi64(quadrant, one), 1), 63));
+        _mm256_storeu_pd(sine + it, _mm256_xor_pd(sin_r, sin_sign));
+        _mm256_storeu_pd(cosine + it, _mm256_xor_pd(cos_r, cos_sign));
+    }
+    sincos_batch_scalar(angle, cosine, sine, it, nb);
+}
+#endif
+
+// sine and cosine of nb angles, on the widest path of the running cpu
+static void sincos_batch(const double* angle, double* cosine, double* sine, size_t nb) {
+    switch (get_physics_batch_path()) {
+#ifdef SLEDGE_HAVE_X86_SIMD
+        case PHYSICS_BATCH_AVX2:
+            sincos_batch_avx2(angle, cosine, sine, nb);
+            break;
+        case PHYSICS_BATCH_SSE2:
+            sincos_batch_sse2(angle, cosine, sine, nb);
+            break;
+#endif
+        default:
+            sincos_batch_scalar(angle, cosine, sine, 0, nb);
+            break;
+    }
+}
+
+// Update every vehicle of a batch. The steps of update_vehicle are run as passes over the arrays, keeping the
+// expressions of the scalar functions. The angles of the two trigonometry steps are gathered first and their sines
+// and cosines computed by sincos_batch, rounded to float for the cosf and sinf of the forward motion
+void update_vehicles(VEHICLE_BATCH* batch, double delta_time) {
+    int n = batch->nb_vehicles;
+    double* x = batch->x;
+    double* y = batch->y;
+    double* speed = batch->speed;
+    double* direction = batch->direction;
+    double* angular_velocity = batch->angular_velocity;
+    double* slip_angle = batch->slip_angle;
+    const double* handbrake = batch->handbrake;
+    double* angle = batch->trig_angle;
+    double* cosine = batch->trig_cos;
+    double* sine = batch->trig_sin;
+
+    // forward motion and direction
+    for (int i = 0; i < n; i++)
+        angle[i] = (float)((direction[i] * PI) / 180.0f);
+    sincos_batch(angle, cosine, sine, n);
+    for (int i = 0; i < n; i++) {
+        x[i] += speed[i] * (float)cosine[i] * delta_time;
+        y[i] += speed[i] * (float)sine[i] * delta_time;
+        direction[i] += angular_velocity[i] * delta_time;
+    }
+    // fmod by one subtraction while the direction stays within two turns, which is exact
+    for (int i = 0; i < n; i++) {
+        if (direction[i] >= 360.0 && direction[i] < 720.0)
+            direction[i] -= 360.0;
+        else if (direction[i] <= -360.0 && direction[i] > -720.0)
+            direction[i] += 360.0;
+        else if (!(fabs(direction[i]) < 360.0))
+            direction[i] = fmod(direction[i], 360.0);
+    }
+
+    // handbrake_vehicle
+    for (int i = 0; i < n; i++) {
+        if (fabs(handbrake[i]) > 0) {
+            speed[i] *= (1.0 - fabs(handbrake[i]) * batch->drag_multiplier[i] * delta_time);
+            angular_velocity[i] += handbrake[i] * batch->angular_velocity_multiplier[i] * delta_time;
+        } else {
+            angular_velocity[i] *= (1.0 - 10.0 * delta_time);
+            if (fabs(angular_velocity[i]) < 0.01)
+                angular_velocity[i] = 0.0;
+        }
+    }
+
+    // update_slip
+    for (int i = 0; i < n; i++) {
+        double lateral_friction = (fabs(handbrake[i]) > 0) ? 0.2 : 0.9;
+        slip_angle[i] = (1.0 - lateral_friction) * angular_velocity[i];
+        angle[i] = (direction[i] + slip_angle[i]) * M_PI / 180.0;
+    }
+    sincos_batch(angle, cosine, sine, n);
+    for (int i = 0; i < n; i++) {
+        x[i] += speed[i] * cosine[i] * delta_time;
+        y[i] += speed[i] * sine[i] * delta_time;
+    }
+
+    // exaggerate_slip, stabilize_traction and the default decay
+    for (int i = 0; i < n; i++) {
+        if (fabs(handbrake[i]) > 0)
+            slip_angle[i] += angular_velocity[i] * batch->slip_factor[i] * delta_time;
+        if (slip_angle[i] > batch->slip_angle_limits[i]) slip_angle[i] = batch->slip_angle_limits[i];
+        if (slip_angle[i] < -batch->slip_angle_limits[i]) slip_angle[i] = -batch->slip_angle_limits[i];
+
+        if (handbrake[i] == 0 && fabs(slip_angle[i]) < 5.0) {
+            angular_velocity[i] *= (1.0 - 5.0 * delta_time);
+            if (fabs(angular_velocity[i]) < 0.01)
+                angular_velocity[i] = 0.0;
+        }
+        angular_velocity[i] *= (1.0 - 1.0 * delta_time);
+        if (fabs(angular_velocity[i]) < 0.01)
+            angular_velocity[i] = 0.0;
+    }
+}
+
+// Free a batch
+void free_vehicle_batch(VEHICLE_BATCH* batch) {
+    if (!batch)
+        return;
+    FreeNoLog(batch->x);
+    batch->y = batch->speed = batch->direction = batch->angular_velocity = batch->slip_angle = batch->handbrake = NULL;
+    batch->slip_factor = batch->angular_velocity_multiplier = batch->drag_multiplier = batch->slip_angle_limits = NULL;
+    batch->trig_angle = batch->trig_cos = batch->trig_sin = NULL;
+    batch->nb_vehicles = 0;
+    batch->max_vehicles = 0;
+}
+
 void calculate_rotated_corners(double dx, double dy, double cx, double cy, double width, double height, double angle, Vector corners[4]) {
     // Bitmap corners relative to its center of rotation (cx, cy)
     Vector points[4] = {
@@ -206,26 +513,6 @@ Vector perpendicular(Vector v) {
     return result;
 }
 
-// Get the minimum projection of corners onto an axis
-double min_projection(Vector axis, Vector corners[4]) {
-    double min = dot_product(axis, corners[0]);
-    for (int i = 1; i < 4; i++) {
-        double projection = dot_product(axis, corners[i]);
-        if (projection < min) min = projection;
-    }
-    return min;
-}
-
-// Get the maximum projection of corners onto an axis
-double max_projection(Vector axis, Vector corners[4]) {
-    double max = dot_product(axis, corners[0]);
-    for (int i = 1; i < 4; i++) {
-        double projection = dot_product(axis, corners[i]);
-        if (projection > max) max = projection;
-    }
-    return max;
-}
-
 // project polygon on axis
 void project_polygon(Vector poly[4], int count, Vector axis, double* min, double* max) {
     *min = *max = (poly[0].x * axis.x + poly[0].y * axis.y);
@@ -236,61 +523,115 @@ void project_polygon(Vector poly[4], int count, Vector axis, double* min, double
     }
 }
 
-// check overlap on axis
-bool overlap_on_axis(Vector poly1[4], Vector poly2[4], Vector axis) {
-    // Project poly1 and poly2 onto the axis
-    double min1, max1, min2, max2;
-    project_polygon(poly1, 4, axis, &min1, &max1);
-    project_polygon(poly2, 4, axis, &min2, &max2);
-
-    // Check if projections overlap
-    return !(max1 < min2 || max2 < min1);
-}
-
-// separated axis theorem collision
-bool sat_collision(Vector poly1[4], Vector poly2[4]) {
-    // Check axes of poly1
-    for (int i = 0; i < 4; i++) {
-        Vector edge = {poly1[(i + 1) % 4].x - poly1[i].x, poly1[(i + 1) % 4].y - poly1[i].y};
-        Vector axis = {-edge.y, edge.x};  // Perpendicular axis
+// Cache the poses of a rotated bitmap moving from one pose to another. The translation is swept exactly. The
+// rotation is split in steps short enough for the bitmap corners to turn by at most SWEPT_ROTATION_TOLERANCE pixels,
+// each step sweeping the bitmap at its mid step angle against rects grown by half that turn, so that a hit is never missed
+void set_collision_shape(CollisionShape* shape, ALLEGRO_BITMAP* bitmap, double cx, double cy, double x0, double y0, double angle0, double x1, double y1, double angle1) {
+    double bitmap_width = al_get_bitmap_width(bitmap);
+    double bitmap_height = al_get_bitmap_height(bitmap);
 
-        if (!overlap_on_axis(poly1, poly2, axis)) {
-            return false;
+    // shortest turn, angles may have wrapped around
+    double turn = remainder(angle1 - angle0, 2.0 * M_PI);
+    double radius = hypot(fmax(cx, bitmap_width - cx), fmax(cy, bitmap_height - cy));
+    int steps = (int)ceil(radius * fabs(turn) / SWEPT_ROTATION_TOLERANCE);
+    if (steps < 1) steps = 1;
+    if (steps > SWEPT_MAX_STEPS) steps = SWEPT_MAX_STEPS;
+    shape->nb_steps = steps;
+    shape->margin = radius * fabs(turn) / steps / 2.0;
+
+    Vector motion = {(x1 - x0) / steps, (y1 - y0) / steps};
+    double min_x = 0, max_x = 0, min_y = 0, max_y = 0;
+    for (int step = 0; step < steps; step++) {
+        CollisionStep* st = &shape->steps[step];
+        Vector corners[4];
+        calculate_rotated_corners(x0 + motion.x * step, y0 + motion.y * step, cx, cy, bitmap_width, bitmap_height, angle0 + turn * (step + 0.5) / steps, corners);
+
+        st->motion = motion;
+        st->min_x = st->max_x = corners[0].x;
+        st->min_y = st->max_y = corners[0].y;
+        for (int i = 1; i < 4; i++) {
+            if (corners[i].x < st->min_x) st->min_x = corners[i].x;
+            if (corners[i].x > st->max_x) st->max_x = corners[i].x;
+            if (corners[i].y < st->min_y) st->min_y = corners[i].y;
+            if (corners[i].y > st->max_y) st->max_y = corners[i].y;
         }
+        // the bitmap is a rectangle, the normals of two adjacent edges are all its separating axes
+        for (int i = 0; i < 2; i++) {
+            st->axes[i] = perpendicular(subtract_vectors(corners[i + 1], corners[i]));
+            project_polygon(corners, 4, st->axes[i], &st->min[i], &st->max[i]);
+            st->speed[i] = dot_product(motion, st->axes[i]);
+        }
+
+        // bounds of the whole step move
+        double step_min_x = st->min_x + fmin(motion.x, 0.0), step_max_x = st->max_x + fmax(motion.x, 0.0);
+        double step_min_y = st->min_y + fmin(motion.y, 0.0), step_max_y = st->max_y + fmax(motion.y, 0.0);
+        if (step == 0 || step_min_x < min_x) min_x = step_min_x;
+        if (step == 0 || step_max_x > max_x) max_x = step_max_x;
+        if (step == 0 || step_min_y < min_y) min_y = step_min_y;
+        if (step == 0 || step_max_y > max_y) max_y = step_max_y;
     }
+    shape->bounds.x = min_x - shape->margin;
+    shape->bounds.y = min_y - shape->margin;
+    shape->bounds.w = max_x - min_x + 2.0 * shape->margin;
+    shape->bounds.h = max_y - min_y + 2.0 * shape->margin;
+}
 
-    // Check axes of poly2
-    for (int i = 0; i < 4; i++) {
-        Vector edge = {poly2[(i + 1) % 4].x - poly2[i].x, poly2[(i + 1) % 4].y - poly2[i].y};
-        Vector axis = {-edge.y, edge.x};  // Perpendicular axis
+// narrow the time interval [t_first, t_last] to when two projections moving apart at speed overlap on an axis.
+// Returns false if they never overlap during it
+static bool sweep_axis(double min1, double max1, double min2, double max2, double speed, double* t_first, double* t_last) {
+    if (speed == 0.0) {
+        // no motion along that axis: separated for good or overlapping all along
+        return !(max1 < min2 || max2 < min1);
+    }
+    double t_enter = (speed > 0.0 ? min2 - max1 : max2 - min1) / speed;
+    double t_exit = (speed > 0.0 ? max2 - min1 : min2 - max1) / speed;
+    if (t_enter > *t_first) *t_first = t_enter;
+    if (t_exit < *t_last) *t_last = t_exit;
+    return *t_first <= *t_last;
+}
 
-        if (!overlap_on_axis(poly1, poly2, axis)) {
-            return false;
+// time of impact of a cached shape against a rect, in [0, 1] of the motion. The rect axes are the x and y axes,
+// so testing them first is a bounding box test that rejects most rects before the bitmap axes. Returns -1 if there is no hit
+double collision_shape_impact(const CollisionShape* shape, CollisionRectangle rect) {
+    double margin = shape->margin;
+    double rect_min_x = rect.x - margin, rect_max_x = rect.x + rect.w + margin;
+    double rect_min_y = rect.y - margin, rect_max_y = rect.y + rect.h + margin;
+    if (shape->bounds.x > rect.x + rect.w || shape->bounds.x + shape->bounds.w < rect.x ||
+        shape->bounds.y > rect.y + rect.h || shape->bounds.y + shape->bounds.h < rect.y)
+        return -1.0;
+
+    double center_x = rect.x + rect.w / 2.0, center_y = rect.y + rect.h / 2.0;
+    double half_w = rect.w / 2.0 + margin, half_h = rect.h / 2.0 + margin;
+    for (int step = 0; step < shape->nb_steps; step++) {
+        const CollisionStep* st = &shape->steps[step];
+        // time interval during which the projections overlap on every axis so far
+        double t_first = 0.0, t_last = 1.0;
+        if (!sweep_axis(st->min_x, st->max_x, rect_min_x, rect_max_x, st->motion.x, &t_first, &t_last) ||
+            !sweep_axis(st->min_y, st->max_y, rect_min_y, rect_max_y, st->motion.y, &t_first, &t_last))
+            continue;
+        bool separated = false;
+        for (int i = 0; i < 2 && !separated; i++) {
+            double center = st->axes[i].x * center_x + st->axes[i].y * center_y;
+            double extent = fabs(st->axes[i].x) * half_w + fabs(st->axes[i].y) * half_h;
+            separated = !sweep_axis(st->min[i], st->max[i], center - extent, center + extent, st->speed[i], &t_first, &t_last);
         }
+        if (!separated)
+            return (step + t_first) / shape->nb_steps;
     }
-
-    return true;  // Collision detected on all axes
+    return -1.0;
 }
 
-// check collisions between rotated bitmap and a rect
-bool check_collision(ALLEGRO_BITMAP* bitmap, double cx, double cy, double dx, double dy, double angle, CollisionRectangle rect) {
-    Vector bitmap_corners[4];
-    double bitmap_width = al_get_bitmap_width(bitmap);
-    double bitmap_height = al_get_bitmap_height(bitmap);
-
-    // Calculate the rotated corners of the bitmap
-    calculate_rotated_corners(dx, dy, cx, cy, bitmap_width, bitmap_height, angle, bitmap_corners);
-
-    // Get the rectangle's corners
-    Vector rect_corners[4] = {
-        {rect.x, rect.y},                    // Top-left
-        {rect.x + rect.w, rect.y},           // Top-right
-        {rect.x + rect.w, rect.y + rect.h},  // Bottom-right
-        {rect.x, rect.y + rect.h}            // Bottom-left
-    };
-
-    // Check for collision using SAT
-    return sat_collision(bitmap_corners, rect_corners);
+// index of the first of rects, from start, that a cached shape hits, or -1. The time of impact goes in impact if not NULL
+int collision_shape_first_hit(const CollisionShape* shape, const CollisionRectangle* rects, int nb_rects, int start, double* impact) {
+    for (int it = start; it < nb_rects; it++) {
+        double toi = collision_shape_impact(shape, rects[it]);
+        if (toi >= 0.0) {
+            if (impact)
+                *impact = toi;
+            return it;
+        }
+    }
+    return -1;
 }
 
 // draw debug collision box
@@ -53,6 +53,25 @@ typedef struct VEHICLE {
 
 } VEHICLE;
 
+// VEHICLE_BATCH structure: many vehicles in structure of arrays form, field[i] being the field of vehicle i
+typedef struct VEHICLE_BATCH {
+    int nb_vehicles;                      // Number of vehicles in the batch
+    int max_vehicles;                     // Size of each array
+    double *x, *y;                        // Positions in units
+    double* speed;                        // Forward speeds in units per second
+    double* direction;                    // Directions in degrees
+    double* angular_velocity;             // Rotation speeds in degrees per second
+    double* slip_angle;                   // Angles of lateral slip in degrees
+    double* handbrake;                    // Handbrake states
+    double* slip_factor;                  // Vehicles properties, as in VEHICLE
+    double* angular_velocity_multiplier;  // Vehicles properties, as in VEHICLE
+    double* drag_multiplier;              // Vehicles properties, as in VEHICLE
+    double* slip_angle_limits;            // Vehicles properties, as in VEHICLE
+    double* trig_angle;                   // Scratch: angles in radians of the batched trigonometry
+    double* trig_cos;                     // Scratch: their cosines
+    double* trig_sin;                     // Scratch: their sines
+} VEHICLE_BATCH;
+
 // calculate points perpandicular to a (x,y) source point and a direction
 void calculate_perpendicular_points(double x, double y, double direction, double distance, double* x1, double* y1, double* x2, double* y2);
 // Initialize a VEHICLE
@@ -71,6 +90,16 @@ void set_handbrake(VEHICLE* vehicle, double value);
 void update_vehicle(VEHICLE* vehicle, double delta_time);
 // Display VEHICLE status
 void print_vehicle(const VEHICLE* vehicle);
+// Allocate a batch for up to max_vehicles vehicles
+bool init_vehicle_batch(VEHICLE_BATCH* batch, int max_vehicles);
+// Copy a VEHICLE at the end of a batch, returning its index or -1 if the batch is full
+int add_vehicle_to_batch(VEHICLE_BATCH* batch, const VEHICLE* vehicle);
+// Copy a vehicle of a batch back to a VEHICLE
+void get_vehicle_from_batch(const VEHICLE_BATCH* batch, int index, VEHICLE* vehicle);
+// Update every vehicle of a batch, as update_vehicle on each of them within rounding: the trigonometry is vectorized
+void update_vehicles(VEHICLE_BATCH* batch, double delta_time);
+// Free a batch
+void free_vehicle_batch(VEHICLE_BATCH* batch);
 
 // Rectangle structure
 typedef struct {
@@ -85,13 +114,37 @@ typedef struct {
 
 // Function prototypes
 // void calculate_rotated_corners(double dx, double dy, double cx, double cy, double width, double height, double angle, Vector corners[4]);
-// bool sat_collision(Vector rectA[4], Vector rectB[4]);
 // Vector subtract_vectors(Vector a, Vector b);
 // double dot_product(Vector a, Vector b);
 // Vector perpendicular(Vector v);
-// double min_projection(Vector axis, Vector corners[4]);
-// double max_projection(Vector axis, Vector corners[4]);
-bool check_collision(ALLEGRO_BITMAP* bitmap, double cx, double cy, double dx, double dy, double angle, CollisionRectangle rect);
+// Largest distance in pixels a bitmap corner may turn by during a collision shape step
+#define SWEPT_ROTATION_TOLERANCE 1.0
+// Maximum number of collision shape steps
+#define SWEPT_MAX_STEPS 16
+
+// One step of a collision shape move
+typedef struct {
+    double min_x, max_x, min_y, max_y;  // Bounds of the bitmap at the step start
+    Vector motion;                      // Move during the step
+    Vector axes[2];                     // Normals of two adjacent bitmap edges
+    double min[2], max[2];              // Bitmap projections on axes
+    double speed[2];                    // Motion projections on axes
+} CollisionStep;
+
+// A rotated bitmap moving from one pose to another, with its corners, axes and bounds computed once for all the rects it is tested against
+typedef struct {
+    int nb_steps;                          // Rotation steps
+    double margin;                         // Tested rects are grown by margin to cover the rotation within a step
+    CollisionRectangle bounds;             // Bounds of the whole move, for broad-phase queries
+    CollisionStep steps[SWEPT_MAX_STEPS];  // Poses of the bitmap
+} CollisionShape;
+
+// cache a rotated bitmap moving from (x0, y0, angle0) to (x1, y1, angle1), the same pose twice for a static test
+void set_collision_shape(CollisionShape* shape, ALLEGRO_BITMAP* bitmap, double cx, double cy, double x0, double y0, double angle0, double x1, double y1, double angle1);
+// time of impact in [0, 1] of a cached shape against a rect, or -1 if they do not touch
+double collision_shape_impact(const CollisionShape* shape, CollisionRectangle rect);
+// index of the first of nb_rects rects, from start, hit by a cached shape, or -1. The time of impact goes in impact if not NULL
+int collision_shape_first_hit(const CollisionShape* shape, const CollisionRectangle* rects, int nb_rects, int start, double* impact);
 void debug_draw_rotated_bitmap(ALLEGRO_BITMAP* bitmap, double cx, double cy, double dx, double dy, double angle);
 
 #ifdef __cplusplus
@@ -0,0 +1,137 @@
+#include "sprite_batch.h"
+#include <stdlib.h>
+#include "nilorea/n_common.h"
+#include "nilorea/n_log.h"
+
+// Initialize an empty batch
+void init_sprite_batch(SpriteBatch* batch) {
+    memset(batch, 0, sizeof(SpriteBatch));
+}
+
+// Queue a bitmap drawing, growing the request array when needed
+bool sprite_batch_draw(SpriteBatch* batch, ALLEGRO_BITMAP* bitmap, float x, float y) {
+    __n_assert(batch, return false);
+    __n_assert(bitmap, return false);
+
+    if (batch->nb_sprites >= batch->max_sprites) {
+        int new_max = batch->max_sprites > 0 ? batch->max_sprites * 2 : 256;
+        SpriteRequest* sprites = realloc(batch->sprites, new_max * sizeof(SpriteRequest));
+        __n_assert(sprites, return false);
+        batch->sprites = sprites;
+        batch->max_sprites = new_max;
+    }
+
+    SpriteRequest* request = &batch->sprites[batch->nb_sprites];
+    request->bitmap = bitmap;
+    request->texture = al_get_parent_bitmap(bitmap);
+    if (!request->texture)
+        request->texture = bitmap;
+    request->x = x;
+    request->y = y;
+    request->order = batch->nb_sprites;
+    batch->nb_sprites++;
+    return true;
+}
+
+// Queue a rectangle outline, growing the request array when needed
+bool sprite_batch_outline(SpriteBatch* batch, float x1, float y1, float x2, float y2, ALLEGRO_COLOR color, float thickness) {
+    __n_assert(batch, return false);
+
+    if (batch->nb_outlines >= batch->max_outlines) {
+        int new_max = batch->max_outlines > 0 ? batch->max_outlines * 2 : 256;
+        OutlineRequest* outlines = realloc(batch->outlines, new_max * sizeof(OutlineRequest));
+        __n_assert(outlines, return false);
+        batch->outlines = outlines;
+        batch->max_outlines = new_max;
+    }
+
+    OutlineRequest* request = &batch->outlines[batch->nb_outlines];
+    request->x1 = x1;
+    request->y1 = y1;
+    request->x2 = x2;
+    request->y2 = y2;
+    request->color = color;
+    request->thickness = thickness;
+    batch->nb_outlines++;
+    return true;
+}
+
+// Order sprites by texture, then by submission
+static int compare_sprite_requests(const void* a, const void* b) {
+    const SpriteRequest* ra = a;
+    const SpriteRequest* rb = b;
+    if (ra->texture != rb->texture)
+        return (uintptr_t)ra->texture < (uintptr_t)rb->texture ? -1 : 1;
+    return ra->order - rb->order;
+}
+
+// Set an outline vertex
+static void set_outline_vertex(ALLEGRO_VERTEX* vertex, float x, float y, ALLEGRO_COLOR color) {
+    vertex->x = x;
+    vertex->y = y;
+    vertex->z = 0;
+    vertex->u = 0;
+    vertex->v = 0;
+    vertex->color = color;
+}
+
+// Draw the pending sprites grouped by texture, then all the outlines as one triangle list
+void flush_sprite_batch(SpriteBatch* batch) {
+    __n_assert(batch, return);
+
+    if (batch->nb_sprites > 0) {
+        qsort(batch->sprites, batch->nb_sprites, sizeof(SpriteRequest), compare_sprite_requests);
+        al_hold_bitmap_drawing(true);
+        for (int it = 0; it < batch->nb_sprites; it++) {
+            al_draw_bitmap(batch->sprites[it].bitmap, batch->sprites[it].x, batch->sprites[it].y, 0);
+        }
+        al_hold_bitmap_drawing(false);
+        batch->nb_sprites = 0;
+    }
+
+    if (batch->nb_outlines > 0) {
+        int nb_vertices = batch->nb_outlines * SPRITE_BATCH_OUTLINE_VERTICES;
+        if (nb_vertices > batch->max_vertices) {
+            ALLEGRO_VERTEX* vertices = realloc(batch->vertices, nb_vertices * sizeof(ALLEGRO_VERTEX));
+            if (!vertices) {
+                n_log(LOG_ERR, "could not allocate %d outline vertices", nb_vertices);
+                batch->nb_outlines = 0;
+                return;
+            }
+            batch->vertices = vertices;
+            batch->max_vertices = nb_vertices;
+        }
+
+        ALLEGRO_VERTEX* vertex = batch->vertices;
+        for (int it = 0; it < batch->nb_outlines; it++) {
+            OutlineRequest* outline = &batch->outlines[it];
+            // outer and inner corners, the outline being centered on the rectangle edges like al_draw_rectangle
+            float half = outline->thickness / 2.0f;
+            float outer[4][2] = {{outline->x1 - half, outline->y1 - half}, {outline->x2 + half, outline->y1 - half}, {outline->x2 + half, outline->y2 + half}, {outline->x1 - half, outline->y2 + half}};
+            float inner[4][2] = {{outline->x1 + half, outline->y1 + half}, {outline->x2 - half, outline->y1 + half}, {outline->x2 - half, outline->y2 - half}, {outline->x1 + half, outline->y2 - half}};
+            for (int edge = 0; edge < 4; edge++) {
+                int next = (edge + 1) % 4;
+                set_outline_vertex(vertex++, outer[edge][0], outer[edge][1], outline->color);
+                set_outline_vertex(vertex++, outer[next][0], outer[next][1], outline->color);
+                set_outline_vertex(vertex++, inner[next][0], inner[next][1], outline->color);
+                set_outline_vertex(vertex++, outer[edge][0], outer[edge][1], outline->color);
+                set_outline_vertex(vertex++, inner[next][0], inner[next][1], outline->color);
+                set_outline_vertex(vertex++, inner[edge][0], inner[edge][1], outline->color);
+            }
+        }
+        al_draw_prim(batch->vertices, NULL, NULL, 0, nb_vertices, ALLEGRO_PRIM_TRIANGLE_LIST);
+        batch->nb_outlines = 0;
+    }
+}
+
+// Free the batch storage
+void free_sprite_batch(SpriteBatch* batch) {
+    if (!batch)
+        return;
+    FreeNoLog(batch->sprites);
+    FreeNoLog(batch->outlines);
+    FreeNoLog(batch->vertices);
+    batch->nb_sprites = batch->max_sprites = 0;
+    batch->nb_outlines = batch->max_outlines = 0;
+    batch->max_vertices = 0;
+}
@@ -0,0 +1,66 @@
+/**\file sprite_batch.h
+ *  deferred sprite and outline drawing for hacks
+ *\author Castagnier Mickaël aka Gull Ra Driel
+ *\version 1.0
+ *\date 16/10/2026
+ */
+
+#ifndef SPRITE_BATCH_HEADER_FOR_HACKS
+#define SPRITE_BATCH_HEADER_FOR_HACKS
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_primitives.h>
+
+// Number of vertices of an outline: four edges of two triangles
+#define SPRITE_BATCH_OUTLINE_VERTICES 24
+
+// A deferred bitmap drawing
+typedef struct {
+    ALLEGRO_BITMAP* bitmap;   // Bitmap to draw
+    ALLEGRO_BITMAP* texture;  // Parent bitmap, or the bitmap itself, used to group the drawings
+    float x, y;               // Destination of the top-left corner
+    int order;                // Submission order, to keep it inside a texture group
+} SpriteRequest;
+
+// A deferred rectangle outline
+typedef struct {
+    float x1, y1, x2, y2;  // Rectangle corners
+    float thickness;       // Outline thickness
+    ALLEGRO_COLOR color;   // Outline color
+} OutlineRequest;
+
+// Draw requests collected during a frame.
+// Sprites are sorted by texture and drawn under al_hold_bitmap_drawing, then all outlines go in a single primitives call
+typedef struct {
+    SpriteRequest* sprites;   // Pending sprites
+    int nb_sprites;           // Number of pending sprites
+    int max_sprites;          // Allocated sprites
+    OutlineRequest* outlines; // Pending outlines
+    int nb_outlines;          // Number of pending outlines
+    int max_outlines;         // Allocated outlines
+    ALLEGRO_VERTEX* vertices; // Outline vertices, reused between frames
+    int max_vertices;         // Allocated vertices
+} SpriteBatch;
+
+// Initialize an empty batch
+void init_sprite_batch(SpriteBatch* batch);
+// Queue a bitmap drawing at (x, y)
+bool sprite_batch_draw(SpriteBatch* batch, ALLEGRO_BITMAP* bitmap, float x, float y);
+// Queue a rectangle outline, like al_draw_rectangle
+bool sprite_batch_outline(SpriteBatch* batch, float x1, float y1, float x2, float y2, ALLEGRO_COLOR color, float thickness);
+// Draw and empty the pending requests: sprites first, then outlines
+void flush_sprite_batch(SpriteBatch* batch);
+// Free the batch storage
+void free_sprite_batch(SpriteBatch* batch);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -14,7 +14,7 @@
 #include "cJSON.h"
 #include "nilorea/n_str.h"
 
-int load_app_state(char* state_filename, long int* WIDTH, long int* HEIGHT, bool* fullscreen, char** bgmusic, double* drawFPS, double* logicFPS) {
+int load_app_state(char* state_filename, long int* WIDTH, long int* HEIGHT, bool* fullscreen, char*** playlist, int* music_buffer_count, int* music_buffer_samples, double* drawFPS, double* logicFPS, int* particle_thread_threshold, int* nb_good_presents, int* nb_bad_presents, long int* world_width, long int* world_height) {
     __n_assert(state_filename, return FALSE);
 
     if (access(state_filename, F_OK) != 0) {
@@ -59,11 +59,39 @@ int load_app_state(char* state_filename, long int* WIDTH, long int* HEIGHT, bool
     } else {
         n_log(LOG_ERR, "fullscreen is not a number");
     }
+    // a single track or a playlist, stored as a NULL terminated array to free with free_split_result
     value = cJSON_GetObjectItemCaseSensitive(monitor_json, "bg-music");
     if (cJSON_IsString(value)) {
-        (*bgmusic) = strdup(value->valuestring);
+        Malloc((*playlist), char*, 2);
+        if ((*playlist))
+            (*playlist)[0] = strdup(value->valuestring);
+    } else if (cJSON_IsArray(value)) {
+        Malloc((*playlist), char*, cJSON_GetArraySize(value) + 1);
+        int nb_tracks = 0;
+        cJSON* track = NULL;
+        cJSON_ArrayForEach(track, value) {
+            if (!(*playlist))
+                break;
+            if (cJSON_IsString(track)) {
+                (*playlist)[nb_tracks++] = strdup(track->valuestring);
+            } else {
+                n_log(LOG_ERR, "bg-music playlist entries must be strings");
+            }
+        }
     } else {
-        n_log(LOG_ERR, "bg-music is not a string");
+        n_log(LOG_ERR, "bg-music is not a string nor an array of strings");
+    }
+    value = cJSON_GetObjectItemCaseSensitive(monitor_json, "musicBufferCount");
+    if (cJSON_IsNumber(value)) {
+        (*music_buffer_count) = value->valueint;
+    } else {
+        n_log(LOG_ERR, "musicBufferCount is not a number");
+    }
+    value = cJSON_GetObjectItemCaseSensitive(monitor_json, "musicBufferSamples");
+    if (cJSON_IsNumber(value)) {
+        (*music_buffer_samples) = value->valueint;
+    } else {
+        n_log(LOG_ERR, "musicBufferSamples is not a number");
     }
     value = cJSON_GetObjectItemCaseSensitive(monitor_json, "drawFPS");
     if (cJSON_IsNumber(value)) {
@@ -77,6 +105,36 @@ int load_app_state(char* state_filename, long int* WIDTH, long int* HEIGHT, bool
     } else {
         n_log(LOG_ERR, "logicFPS is not a number");
     }
+    value = cJSON_GetObjectItemCaseSensitive(monitor_json, "particleThreadThreshold");
+    if (cJSON_IsNumber(value)) {
+        (*particle_thread_threshold) = value->valueint;
+    } else {
+        n_log(LOG_ERR, "particleThreadThreshold is not a number");
+    }
+    value = cJSON_GetObjectItemCaseSensitive(monitor_json, "nbGoodPresents");
+    if (cJSON_IsNumber(value)) {
+        (*nb_good_presents) = value->valueint;
+    } else {
+        n_log(LOG_ERR, "nbGoodPresents is not a number");
+    }
+    value = cJSON_GetObjectItemCaseSensitive(monitor_json, "nbBadPresents");
+    if (cJSON_IsNumber(value)) {
+        (*nb_bad_presents) = value->valueint;
+    } else {
+        n_log(LOG_ERR, "nbBadPresents is not a number");
+    }
+    value = cJSON_GetObjectItemCaseSensitive(monitor_json, "worldWidth");
+    if (cJSON_IsNumber(value)) {
+        (*world_width) = value->valueint;
+    } else {
+        n_log(LOG_ERR, "worldWidth is not a number");
+    }
+    value = cJSON_GetObjectItemCaseSensitive(monitor_json, "worldHeight");
+    if (cJSON_IsNumber(value)) {
+        (*world_height) = value->valueint;
+    } else {
+        n_log(LOG_ERR, "worldHeight is not a number");
+    }
 
     cJSON_Delete(monitor_json);
     free_nstr(&data);
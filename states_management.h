@@ -37,7 +37,7 @@ enum APP_KEYS {
     KEY_F6
 };
 
-int load_app_state(char* state_filename, long int* WIDTH, long int* HEIGHT, bool* fullscreen, char** bgmusic, double* drawFPS, double* logicFPS);
+int load_app_state(char* state_filename, long int* WIDTH, long int* HEIGHT, bool* fullscreen, char*** playlist, int* music_buffer_count, int* music_buffer_samples, double* drawFPS, double* logicFPS, int* particle_thread_threshold, int* nb_good_presents, int* nb_bad_presents, long int* world_width, long int* world_height);
 
 #ifdef __cplusplus
 }
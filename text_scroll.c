@@ -1,6 +1,42 @@
 #include "text_scroll.h"
+#include <stdlib.h>
 
-// Initialize the text manager
+// Shadows offset, in pixels
+#define TEXT_SHADOW_OFFSET 2
+
+// Rasterize a line and its red, green and blue shadows in a bitmap, once. The shadows are drawn as they were on screen,
+// red on top left, green in the middle, blue on bottom right, so blitting the bitmap gives the same picture
+static void render_text_line(TextManager* tm, int i) {
+    TextLine* line = &tm->rendered[i];
+    line->bitmap = NULL;
+    line->cached = true;
+
+    int bbx = 0, bby = 0, bbw = 0, bbh = 0;
+    al_get_text_dimensions(tm->font, tm->lines[i], &bbx, &bby, &bbw, &bbh);
+    if (bbw <= 0 || bbh <= 0)
+        return;  // Nothing to draw
+
+    line->bitmap = al_create_bitmap(bbw + 2 * TEXT_SHADOW_OFFSET, bbh + 2 * TEXT_SHADOW_OFFSET);
+    if (!line->bitmap) {
+        line->cached = false;  // Fall back to drawing the text
+        return;
+    }
+    // Bitmap top left corner, relative to where the centered green line starts
+    float text_width = al_get_text_width(tm->font, tm->lines[i]);
+    line->offset_x = -text_width / 2 + bbx - TEXT_SHADOW_OFFSET;
+    line->offset_y = bby - TEXT_SHADOW_OFFSET;
+
+    ALLEGRO_STATE state;
+    al_store_state(&state, ALLEGRO_STATE_TARGET_BITMAP);
+    al_set_target_bitmap(line->bitmap);
+    al_clear_to_color(al_map_rgba(0, 0, 0, 0));
+    al_draw_text(tm->font, al_map_rgb(255, 0, 0), -bbx, -bby, ALLEGRO_ALIGN_LEFT, tm->lines[i]);
+    al_draw_text(tm->font, al_map_rgb(0, 255, 0), -bbx + TEXT_SHADOW_OFFSET, -bby + TEXT_SHADOW_OFFSET, ALLEGRO_ALIGN_LEFT, tm->lines[i]);
+    al_draw_text(tm->font, al_map_rgb(0, 0, 255), -bbx + 2 * TEXT_SHADOW_OFFSET, -bby + 2 * TEXT_SHADOW_OFFSET, ALLEGRO_ALIGN_LEFT, tm->lines[i]);
+    al_restore_state(&state);
+}
+
+// Initialize the text manager, rendering the lines in bitmaps. Needs the display
 void init_text_manager(TextManager* tm, const char** lines, int num_lines, ALLEGRO_FONT* font, float scroll_speed, int SCREEN_HEIGHT) {
     tm->lines = lines;
     tm->num_lines = num_lines;
@@ -8,19 +44,34 @@ void init_text_manager(TextManager* tm, const char** lines, int num_lines, ALLEG
     tm->scroll_speed = scroll_speed;
     tm->position_y = SCREEN_HEIGHT;  // Start below the screen
     tm->font = font;
+    tm->line_height = al_get_font_line_height(font);
     tm->is_done = false;
+
+    // Without a cache every line is drawn with al_draw_text
+    tm->rendered = calloc(num_lines, sizeof(TextLine));
+    if (tm->rendered) {
+        for (int i = 0; i < num_lines; i++)
+            render_text_line(tm, i);
+    }
 }
 
 // Render text
 void render_text_manager(TextManager* tm, int SCREEN_WIDTH, int SCREEN_HEIGHT) {
     for (int i = tm->current_line; i < tm->num_lines; i++) {
-        float y = tm->position_y + (i - tm->current_line) * al_get_font_line_height(tm->font);
-        if (y >= SCREEN_HEIGHT || y + al_get_font_line_height(tm->font) < 0) {
+        float y = tm->position_y + (i - tm->current_line) * tm->line_height;
+        if (y >= SCREEN_HEIGHT)
+            break;  // Next lines are lower
+        if (y + tm->line_height < 0) {
             continue;  // Skip if out of screen
         }
-        al_draw_text(tm->font, al_map_rgb(255, 0, 0), (SCREEN_WIDTH / 2) - 2, y - 2, ALLEGRO_ALIGN_CENTER, tm->lines[i]);
+        if (tm->rendered && tm->rendered[i].cached) {
+            if (tm->rendered[i].bitmap)
+                al_draw_bitmap(tm->rendered[i].bitmap, (SCREEN_WIDTH / 2) + tm->rendered[i].offset_x, y + tm->rendered[i].offset_y, 0);
+            continue;
+        }
+        al_draw_text(tm->font, al_map_rgb(255, 0, 0), (SCREEN_WIDTH / 2) - TEXT_SHADOW_OFFSET, y - TEXT_SHADOW_OFFSET, ALLEGRO_ALIGN_CENTER, tm->lines[i]);
         al_draw_text(tm->font, al_map_rgb(0, 255, 0), (SCREEN_WIDTH / 2), y, ALLEGRO_ALIGN_CENTER, tm->lines[i]);
-        al_draw_text(tm->font, al_map_rgb(0, 0, 255), (SCREEN_WIDTH / 2) + 2, y + 2, ALLEGRO_ALIGN_CENTER, tm->lines[i]);
+        al_draw_text(tm->font, al_map_rgb(0, 0, 255), (SCREEN_WIDTH / 2) + TEXT_SHADOW_OFFSET, y + TEXT_SHADOW_OFFSET, ALLEGRO_ALIGN_CENTER, tm->lines[i]);
     }
 }
 
@@ -31,14 +82,26 @@ void update_text_manager(TextManager* tm, float delta_time) {
     tm->position_y -= tm->scroll_speed * delta_time;  // Scroll the text
                                                       // Check if the last line is fully off the screen
     if (tm->current_line == tm->num_lines - 1 &&
-        tm->position_y + al_get_font_line_height(tm->font) < 0) {
+        tm->position_y + tm->line_height < 0) {
         tm->is_done = true;  // Scrolling complete
     }
-    if (tm->position_y + al_get_font_line_height(tm->font) < 0) {
+    if (tm->position_y + tm->line_height < 0) {
         tm->current_line++;
-        tm->position_y += al_get_font_line_height(tm->font);
+        tm->position_y += tm->line_height;
         if (tm->current_line >= tm->num_lines) {
             tm->current_line = tm->num_lines - 1;  // Prevent overflow
         }
     }
 }
+
+// Free the rendered lines
+void free_text_manager(TextManager* tm) {
+    if (!tm->rendered)
+        return;
+    for (int i = 0; i < tm->num_lines; i++) {
+        if (tm->rendered[i].bitmap)
+            al_destroy_bitmap(tm->rendered[i].bitmap);
+    }
+    free(tm->rendered);
+    tm->rendered = NULL;
+}
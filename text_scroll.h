@@ -18,11 +18,21 @@ extern "C" {
 #include <allegro5/allegro_primitives.h>
 #include <stdio.h>
 
+// A line rasterized once with its red, green and blue shadows
+typedef struct {
+    ALLEGRO_BITMAP* bitmap;  // Rendered line, NULL for blank lines or if it could not be created
+    bool cached;             // false if the line has to be drawn with al_draw_text
+    float offset_x;          // Bitmap position relative to the line center
+    float offset_y;          // Bitmap position relative to the line top
+} TextLine;
+
 // Define a simple text manager structure
 typedef struct {
     const char** lines;  // Array of strings to display
+    TextLine* rendered;  // Lines rasterized at init, one per string
     int num_lines;       // Total number of lines
     int current_line;    // Current line to display
+    int line_height;     // Font line height
     float scroll_speed;  // Speed of scrolling
     float position_y;    // Current Y position
     ALLEGRO_FONT* font;  // Font to render text
@@ -32,6 +42,7 @@ typedef struct {
 void init_text_manager(TextManager* tm, const char** lines, int num_lines, ALLEGRO_FONT* font, float scroll_speed, int SCREEN_HEIGHT);
 void render_text_manager(TextManager* tm, int SCREEN_WIDTH, int SCREEN_HEIGHT);
 void update_text_manager(TextManager* tm, float delta_time);
+void free_text_manager(TextManager* tm);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,104 @@
+/**\file vehicle_bench.c
+ *  Benchmark of the vehicle batch physics against update_vehicle
+ *\author Castagnier Mickaël aka Gull Ra Driel
+ *\version 1.0
+ *\date 16/10/2026
+ */
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nilorea/n_common.h"
+#include "nilorea/n_log.h"
+#include "nilorea/n_time.h"
+
+#include "game_random.h"
+#include "sledge_physics.h"
+
+// Logic step of the game, in seconds
+#define BENCH_DELTA_TIME (1.0 / 240.0)
+// Largest difference accepted on the fields that do not go through the trigonometry
+#define BENCH_TOLERANCE 1e-9
+
+// random double between min and max, from the world stream
+double bench_rand(double min, double max) {
+    return min + (max - min) * game_rand(RANDOM_WORLD) / (double)GAME_RAND_MAX;
+}
+
+// update nb_vehicles random vehicles for ticks ticks with update_vehicle, then the same ones in a batch with
+// update_vehicles, print both timings and how far the batch ends from the scalar path, and fail if it is beyond
+// tolerance. The batch sines and cosines may round one float ulp apart from cosf and sinf, which moves a position
+// by up to MAX_SPEED * FLT_EPSILON * BENCH_DELTA_TIME at each tick, so positions are allowed that much per tick
+int main(int argc, char* argv[]) {
+    set_log_level(LOG_NOTICE);
+
+    long int nb_vehicles = (argc > 1) ? strtol(argv[1], NULL, 10) : 1000;
+    long int ticks = (argc > 2) ? strtol(argv[2], NULL, 10) : 1000;
+    if (nb_vehicles <= 0 || nb_vehicles > 10000000 || ticks <= 0) {
+        fprintf(stderr, "usage: %s [nb_vehicles] [ticks]\n", argv[0]);
+        exit(1);
+    }
+    seed_game_random(1);
+
+    VEHICLE* vehicles = NULL;
+    Malloc(vehicles, VEHICLE, nb_vehicles);
+    __n_assert(vehicles, exit(1));
+    VEHICLE_BATCH batch;
+    if (!init_vehicle_batch(&batch, (int)nb_vehicles)) {
+        Free(vehicles);
+        exit(1);
+    }
+    // a third of them with the handbrake on, so that both sides of every test are run
+    for (int it = 0; it < nb_vehicles; it++) {
+        VEHICLE* vehicle = &vehicles[it];
+        init_vehicle(vehicle, bench_rand(-4000.0, 4000.0), bench_rand(-4000.0, 4000.0));
+        set_vehicle_properties(vehicle, bench_rand(0.0, 5.0), bench_rand(10.0, 45.0), bench_rand(75.0, 150.0), bench_rand(0.2, 1.5));
+        vehicle->speed = bench_rand(0.0, MAX_SPEED);
+        vehicle->direction = bench_rand(0.0, 360.0);
+        vehicle->angular_velocity = bench_rand(-100.0, 100.0);
+        set_handbrake(vehicle, (it % 3 == 0) ? bench_rand(-1.0, 1.0) : 0.0);
+        add_vehicle_to_batch(&batch, vehicle);
+    }
+
+    N_TIME chrono;
+    start_HiTimer(&chrono);
+    for (long int tick = 0; tick < ticks; tick++) {
+        for (int it = 0; it < nb_vehicles; it++)
+            update_vehicle(&vehicles[it], BENCH_DELTA_TIME);
+    }
+    double scalar_usec = get_usec(&chrono);
+
+    start_HiTimer(&chrono);
+    for (long int tick = 0; tick < ticks; tick++)
+        update_vehicles(&batch, BENCH_DELTA_TIME);
+    double batch_usec = get_usec(&chrono);
+
+    double position_tolerance = (double)ticks * MAX_SPEED * FLT_EPSILON * BENCH_DELTA_TIME;
+    double max_position_diff = 0.0;
+    double max_diff = 0.0;
+    int nb_identical = 0;
+    for (int it = 0; it < nb_vehicles; it++) {
+        VEHICLE batched;
+        get_vehicle_from_batch(&batch, it, &batched);
+        double fields[6][2] = {{vehicles[it].x, batched.x}, {vehicles[it].y, batched.y}, {vehicles[it].speed, batched.speed}, {vehicles[it].direction, batched.direction}, {vehicles[it].angular_velocity, batched.angular_velocity}, {vehicles[it].slip_angle, batched.slip_angle}};
+        bool identical = true;
+        for (int field = 0; field < 6; field++) {
+            double diff = fabs(fields[field][0] - fields[field][1]);
+            if (field < 2)
+                max_position_diff = fmax(max_position_diff, diff);
+            else
+                max_diff = fmax(max_diff, diff);
+            identical &= !memcmp(&fields[field][0], &fields[field][1], sizeof(double));
+        }
+        nb_identical += identical;
+    }
+    printf("vehicles: %ld, %ld ticks: scalar %.3f ms, batch %.3f ms, x%.2f\n", nb_vehicles, ticks, scalar_usec / 1000.0, batch_usec / 1000.0, batch_usec > 0 ? scalar_usec / batch_usec : 0.0);
+    printf("largest difference: positions %g (tolerance %g), others %g (tolerance %g), %d/%ld vehicles identical to the bit\n", max_position_diff, position_tolerance, max_diff, BENCH_TOLERANCE, nb_identical, nb_vehicles);
+
+    free_vehicle_batch(&batch);
+    Free(vehicles);
+    return (max_position_diff <= position_tolerance && max_diff <= BENCH_TOLERANCE) ? 0 : 1;
+}
@@ -0,0 +1,65 @@
+#include "world_snapshot.h"
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include "nilorea/n_common.h"
+#include "nilorea/n_log.h"
+
+// Allocate the slots. The consumer starts on slot 0, the producer on slot 1, slot 2 is ready but not fresh
+bool init_snapshot_buffer(SnapshotBuffer* buffer, int max_objects, int max_sprites) {
+    __n_assert(buffer, return false);
+
+    memset(buffer, 0, sizeof(SnapshotBuffer));
+    for (int it = 0; it < SNAPSHOT_SLOTS; it++) {
+        WorldSnapshot* snapshot = &buffer->slots[it];
+        snapshot->objects = calloc(max_objects, sizeof(SnapshotObject));
+        if (!snapshot->objects) {
+            n_log(LOG_ERR, "could not allocate %d snapshot objects", max_objects);
+            free_snapshot_buffer(buffer);
+            return false;
+        }
+        snapshot->max_objects = max_objects;
+        if (init_particle_system(&snapshot->particles, INT_MAX, 0, 0, 0, max_sprites) != TRUE) {
+            n_log(LOG_ERR, "could not create snapshot particle system");
+            free_snapshot_buffer(buffer);
+            return false;
+        }
+    }
+    buffer->front = 0;
+    buffer->back = 1;
+    buffer->latest = 2;
+    return true;
+}
+
+// Get the slot to fill
+WorldSnapshot* snapshot_back(SnapshotBuffer* buffer) {
+    return &buffer->slots[buffer->back];
+}
+
+// Swap the filled slot with the ready one. The release makes the slot content visible before its index
+void publish_snapshot(SnapshotBuffer* buffer) {
+    int previous = __atomic_exchange_n(&buffer->latest, buffer->back | SNAPSHOT_FRESH, __ATOMIC_ACQ_REL);
+    buffer->back = previous & ~SNAPSHOT_FRESH;
+}
+
+// Swap the front slot with the ready one when it was published since the last call
+WorldSnapshot* latest_snapshot(SnapshotBuffer* buffer) {
+    if (__atomic_load_n(&buffer->latest, __ATOMIC_ACQUIRE) & SNAPSHOT_FRESH) {
+        int previous = __atomic_exchange_n(&buffer->latest, buffer->front, __ATOMIC_ACQ_REL);
+        buffer->front = previous & ~SNAPSHOT_FRESH;
+    }
+    return &buffer->slots[buffer->front];
+}
+
+// Free the slots
+void free_snapshot_buffer(SnapshotBuffer* buffer) {
+    if (!buffer)
+        return;
+    for (int it = 0; it < SNAPSHOT_SLOTS; it++) {
+        FreeNoLog(buffer->slots[it].objects);
+        if (buffer->slots[it].particles)
+            free_particle_system(&buffer->slots[it].particles);
+        buffer->slots[it].max_objects = 0;
+        buffer->slots[it].nb_objects = 0;
+    }
+}
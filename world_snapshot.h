@@ -0,0 +1,77 @@
+/**\file world_snapshot.h
+ *  world snapshots handed from the logic thread to the display thread for hacks
+ *\author Castagnier Mickaël aka Gull Ra Driel
+ *\version 1.0
+ *\date 16/10/2026
+ */
+
+#ifndef WORLD_SNAPSHOT_HEADER_FOR_HACKS
+#define WORLD_SNAPSHOT_HEADER_FOR_HACKS
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "nilorea/n_particles.h"
+#include "sledge_physics.h"
+
+// Number of snapshots: one being written, one being drawn, one ready to be taken
+#define SNAPSHOT_SLOTS 3
+// Set on SnapshotBuffer.latest while the ready snapshot has not been taken yet
+#define SNAPSHOT_FRESH 4
+
+// Copy of an object near the camera
+typedef struct {
+    int type;                 // Object kind, as in the game objects
+    int id;                   // Icon id
+    CollisionRectangle rect;  // World rectangle
+} SnapshotObject;
+
+// Everything the display thread needs to draw a frame, copied by the logic thread after its ticks
+typedef struct {
+    VEHICLE sledge;                  // Sledge after the last tick
+    double previous_x, previous_y;   // Sledge position before the last tick
+    double previous_direction;       // Sledge direction before the last tick
+    double tick_time;                // al_get_time() at which the last tick was due
+    bool has_target;                 // false once all the gifts are collected
+    CollisionRectangle target;       // Gift to collect next
+    int nb_good_presents;            // Gifts left
+    int nb_bad_presents;             // Krampus items left
+    long int max_time;               // Time left, in usecs
+    bool done;                       // The game is over
+    bool intro_scrolling;            // false once the player accelerated, the intro text stops
+    SnapshotObject* objects;         // Objects near the camera
+    int nb_objects;                  // Number of objects
+    int max_objects;                 // Size of objects
+    PARTICLE_SYSTEM* particles;      // Particles near the camera
+} WorldSnapshot;
+
+// Triple buffer: the producer fills the back slot and swaps it with the ready one, the consumer
+// swaps its front slot with the ready one when a newer snapshot was published. Both swaps are a
+// single atomic exchange on latest, so neither side ever waits for the other
+typedef struct {
+    WorldSnapshot slots[SNAPSHOT_SLOTS];  // Snapshots storage
+    int back;                             // Slot owned by the producer
+    int front;                            // Slot owned by the consumer
+    int latest;                           // Ready slot, | SNAPSHOT_FRESH until the consumer takes it
+} SnapshotBuffer;
+
+// Allocate the slots, each holding up to max_objects objects and particles using max_sprites sprites
+bool init_snapshot_buffer(SnapshotBuffer* buffer, int max_objects, int max_sprites);
+// Producer: get the slot to fill
+WorldSnapshot* snapshot_back(SnapshotBuffer* buffer);
+// Producer: make the filled slot the ready one
+void publish_snapshot(SnapshotBuffer* buffer);
+// Consumer: take the ready slot if it is newer than the front one, and get the front one
+WorldSnapshot* latest_snapshot(SnapshotBuffer* buffer);
+// Free the slots
+void free_snapshot_buffer(SnapshotBuffer* buffer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif